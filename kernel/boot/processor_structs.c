@@ -108,6 +108,10 @@ static void setup_gdt(void)
 		ACC_PL_U | ACC_CODE_R, SZ_32);
 	fill_descriptor(&gdt[USER_DS / 8], 0, 0xffffffff,
 		ACC_PL_U | ACC_DATA_W, SZ_32);
+	fill_descriptor(&gdt[SYSEXIT_USER_CS / 8], 0, 0xffffffff,
+		ACC_PL_U | ACC_CODE_R, SZ_32);
+	fill_descriptor(&gdt[SYSEXIT_USER_DS / 8], 0, 0xffffffff,
+		ACC_PL_U | ACC_DATA_W, SZ_32);
 
 	for (i=0; i<HANDLER_ENTRIES; i++) {
 		fill_descriptor(&gdt[i + (TRAP_TSS_BASE / 8)], trap_tss + i,
@@ -0,0 +1,34 @@
+#!/bin/bash
+#
+# Resolve kernel addresses to functions and source lines, for example
+# the call sites printed by the 'memtrace' shell command when the
+# kernel is built with MEM_TRACE=1.
+#
+# Usage: build/symbolize.sh [kernel.bin] < dump.txt
+#        build/symbolize.sh [kernel.bin] 0x00101234 ...
+#
+
+KERNEL=out/kernel.bin
+if [ -n "$1" -a -f "$1" ]; then
+    KERNEL=$1
+    shift
+fi
+
+if [ ! -f "${KERNEL}" ]; then
+    echo "Kernel binary not found: ${KERNEL}" >&2
+    exit 1
+fi
+
+if [ $# -ne 0 ]; then
+    addr2line -f -p -e "${KERNEL}" "$@"
+else
+    # Keep the dump lines and append the resolved symbol to each of them.
+    while IFS= read -r line; do
+        addr=`echo "${line}" | grep -o -m 1 '0x[0-9a-fA-F]\{8\}'`
+        if [ -n "${addr}" ]; then
+            echo "${line}  $(addr2line -f -p -e "${KERNEL}" "${addr}")"
+        else
+            echo "${line}"
+        fi
+    done
+fi
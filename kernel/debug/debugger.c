@@ -3,6 +3,7 @@
 #include "../boot/processor_structs.h"
 #include "gdb_serial_support.h"
 #include "cpu.h"
+#include "cga.h"
 #include "string.h"
 
 static int do_debug = 0;
@@ -205,6 +206,7 @@ void trap_handler(unsigned trapno, unsigned error_code)
 	} else {
 		char d = 1;
 		char video_mem[4000];
+		screen_base = cga_screen_base();
 		memcpy(video_mem, screen_base, sizeof(video_mem));
 		dump_registers(trapno, error_code, t);
 		while (1) {
@@ -43,4 +43,18 @@ void cga_clear(void);
 /// Scroll down the screen.
 void cga_scroll_down(void);
 
+/// Scroll the view in the history by the given number of lines, back
+/// if positive, toward the screen if negative. Output continues to
+/// the screen while the view is scrolled back.
+void cga_scroll_view(int32_t lines);
+/// Scroll the view back to the screen.
+void cga_view_reset(void);
+
+/// All functions above only modify a shadow buffer, this function
+/// copies the modified lines and the cursor to the screen.
+void cga_flush(void);
+/// Return the address of the first character of the screen in video
+/// memory, which moves when scrolling.
+void *cga_screen_base(void);
+
 #endif
@@ -23,11 +23,20 @@ void cons_write(const char *src, size_t len);
 /// before reaching 'len', the full line is copied (but '\n' is not
 /// returned).
 ///
-/// If given 'len' is 0, true is returned and length is unchanged.
+/// The destination is in the reader's memory and copied with
+/// 'copy_to_user', -1 is returned and nothing is consumed if it's
+/// invalid. Else 1 is returned if characters have been read.
+///
+/// If given 'len' is 0, 1 is returned and length is unchanged.
 /// 
-/// If not enough data is available this function returns false. If 
+/// If not enough data is available this function returns 0. If 
 /// the given 'wake' function pointer is not null, it will be called 
 /// when enough data is available.
-bool cons_try_read(char *dst, size_t *len, cons_wake_t wake);
+int cons_try_read(char *dst, size_t *len, cons_wake_t wake);
+
+/// Return true if a line can be read from the console's global buffer,
+/// without reading it. Else, if the given 'wake' function pointer is 
+/// not null, it will be called when data is available.
+bool cons_poll(cons_wake_t wake);
 
 #endif
@@ -115,4 +115,17 @@ __inline__ static unsigned long inl(unsigned short port)
 	return rega;
 }
 
+__inline__ static void cpuid(unsigned long leaf, unsigned long *eax, unsigned long *ebx, unsigned long *ecx, unsigned long *edx)
+{
+	__asm__ __volatile__("cpuid"
+		: "=a" (*eax), "=b" (*ebx), "=c" (*ecx), "=d" (*edx)
+		: "a" (leaf), "c" (0));
+}
+
+__inline__ static void wrmsr(unsigned long msr, unsigned long long value)
+{
+	__asm__ __volatile__("wrmsr"
+		: : "c" (msr), "a" ((unsigned long) value), "d" ((unsigned long) (value >> 32)));
+}
+
 #endif
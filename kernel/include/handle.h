@@ -0,0 +1,64 @@
+/// Growable handle tables, mapping integer handles to objects. Tables
+/// are two-level: a fixed directory of chunks, that are allocated on
+/// demand. Handles encode a generation counter in their high bits, so
+/// a stale handle to a freed object does not address a new one.
+
+#ifndef __HANDLE_H__
+#define __HANDLE_H__
+
+#include "stddef.h"
+#include "stdint.h"
+#include "stdbool.h"
+
+
+#define HANDLE_CHUNK_BITS 6
+#define HANDLE_CHUNK_CAP (1 << HANDLE_CHUNK_BITS)
+#define HANDLE_DIR_BITS 10
+#define HANDLE_DIR_CAP (1 << HANDLE_DIR_BITS)
+/// Low bits of a handle giving its index in the table.
+#define HANDLE_INDEX_BITS (HANDLE_CHUNK_BITS + HANDLE_DIR_BITS)
+/// Remaining bits (sign excluded) give the generation of the entry.
+#define HANDLE_GENERATION_MASK ((1u << (31 - HANDLE_INDEX_BITS)) - 1)
+
+struct handle_entry {
+    /// The object, null if the entry is free.
+    void *object;
+    /// Incremented each time the entry is freed.
+    uint32_t generation;
+    /// Next free entry index if free, -1 for the last one.
+    int next_free;
+};
+
+struct handle_table {
+    /// Maximum number of live handles.
+    size_t max;
+    /// Current number of live handles.
+    size_t count;
+    /// Number of entries in allocated chunks.
+    size_t capacity;
+    /// Index of the first free entry, -1 if none.
+    int free;
+    /// Chunks of entries, allocated on demand.
+    struct handle_entry *chunks[HANDLE_DIR_CAP];
+};
+
+/// Static initializer of a handle table with the given maximum number
+/// of live handles, it can't be higher than the index space.
+#define HANDLE_TABLE_INIT(max_count) { .max = (max_count), .count = 0, .capacity = 0, .free = -1 }
+
+/// Return true if no more handle can be allocated in the table.
+static inline bool handle_table_full(const struct handle_table *table) {
+    return table->count >= table->max;
+}
+
+/// Allocate a handle for the given (non-null) object, returning -1 if
+/// the table is full or if a new chunk can't be allocated. The first
+/// handles of a table are equal to their index.
+int handle_alloc(struct handle_table *table, void *object);
+/// Free a handle, it must be valid.
+void handle_free(struct handle_table *table, int handle);
+/// Get the object of a handle in constant time, returning null if the
+/// handle is invalid, free or stale.
+void *handle_get(const struct handle_table *table, int handle);
+
+#endif
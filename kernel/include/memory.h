@@ -4,8 +4,13 @@
 #define __MEMORY_H__
 
 #include "stddef.h"
+#include "stdbool.h"
+#include "syscall_shared.h"
 
 #define PAGE_SIZE 4096
+/// Size of a cache line, to be used with 'kalloc_aligned' for hot
+/// structures that should not share their lines.
+#define CACHE_LINE_SIZE 64
 
 
 /// Initialize the memory allocation system of the kernel. This must
@@ -23,9 +28,32 @@ size_t page_capacity(void);
 /// Get the current allocation count.
 size_t page_used(void);
 
-// TODO: Alignment guarantees.
+/// Map pages allocated with 'page_alloc' in the user mapping window,
+/// returning the user address, or null if the window is full. The
+/// mapping is visible to all processes.
+void *page_map_user(void *ptr, size_t size);
+/// Same as 'page_map_user', but the pages can't be written by users.
+void *page_map_user_read_only(void *ptr, size_t size);
+/// Unmap pages previously mapped with 'page_map_user'.
+void page_unmap_user(void *addr, size_t size);
+/// Return true if the given pointer is in a mapped page of the user
+/// mapping window, that is writable by users.
+bool page_user_mapped(const void *ptr);
+
+/// Kernel allocation function, return null if failing. The allocated
+/// pointer is aligned to two words (8 bytes).
 void *kalloc(size_t size);
+/// Kernel allocation function with a given alignment, that must be a
+/// power of two, return null if failing or if alignment is invalid.
+/// The pointer can be freed with 'kfree' like any other.
+void *kalloc_aligned(size_t size, size_t align);
 /// Free a pointer allocated with 'kalloc'.
 void kfree(void *ptr);
 
+/// Get live allocations grouped by call site, sorted by decreasing
+/// bytes, up to 'count' sites are written to the given array and the
+/// number of sites is returned. Only available if the kernel is built
+/// with 'MEM_TRACE=1', return -1 otherwise.
+int mem_trace_sites(struct mem_trace_site *sites, int count);
+
 #endif
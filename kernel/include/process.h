@@ -5,6 +5,7 @@
 #include "stdint.h"
 #include "stddef.h"
 #include <stddef.h>
+#include "syscall_shared.h"
 
 #define PROCESS_NAME_CAP        128
 #define PROCESS_STACK_SIZE      512
@@ -14,6 +15,13 @@
 
 typedef int pid_t;
 typedef int qid_t;
+typedef int did_t;
+typedef int tid_t;
+typedef int shmid_t;
+typedef int semid_t;
+typedef int mutexid_t;
+typedef int condid_t;
+typedef int barrierid_t;
 
 /// Type alias for process entry point.
 typedef int (*process_entry_t)(void *);
@@ -61,24 +69,212 @@ int process_state(pid_t pid);
 /// Pause the process for given number of clock cycles.
 void process_wait_clock(uint32_t clock);
 
+/// Create a counting semaphore with the given initial count.
+semid_t process_sem_create(int count);
+/// Delete a semaphore, waiting processes return -1.
+int process_sem_delete(semid_t id);
+/// Decrement the semaphore, blocking while its count is zero.
+int process_sem_wait(semid_t id);
+/// Same as 'process_sem_wait' but returns 'SYSCALL_WOULD_BLOCK'
+/// instead of blocking.
+int process_sem_try_wait(semid_t id);
+/// Increment the semaphore count times, waking up waiting processes
+/// in priority order.
+int process_sem_signal(semid_t id, int count);
+/// Return the count of the semaphore, or the negative number of
+/// waiting processes.
+int process_sem_count(semid_t id);
+/// Set the count of the semaphore, waiting processes return -1.
+int process_sem_reset(semid_t id, int count);
+
+/// Create a mutex, initially unlocked.
+mutexid_t process_mutex_create(void);
+/// Delete a mutex, waiting processes return -1.
+int process_mutex_delete(mutexid_t id);
+/// Lock the mutex, blocking while it is owned by another process,
+/// returns -1 if already owned by the current process.
+int process_mutex_lock(mutexid_t id);
+/// Same as 'process_mutex_lock' but returns 'SYSCALL_WOULD_BLOCK'
+/// instead of blocking.
+int process_mutex_try_lock(mutexid_t id);
+/// Unlock the mutex, that must be owned by the current process, the
+/// ownership is given to the highest priority waiting process.
+int process_mutex_unlock(mutexid_t id);
+
+/// Create a condition variable.
+condid_t process_cond_create(void);
+/// Delete a condition variable, waiting processes return -1.
+int process_cond_delete(condid_t id);
+/// Atomically unlock the mutex (owned by the current process) and
+/// wait for the condition, the mutex is owned again when returning 0.
+int process_cond_wait(condid_t id, mutexid_t mutex_id);
+/// Wake up the highest priority process waiting for the condition.
+int process_cond_signal(condid_t id);
+/// Wake up all processes waiting for the condition.
+int process_cond_broadcast(condid_t id);
+
+/// Create a barrier for the given number of processes.
+barrierid_t process_barrier_create(int count);
+/// Delete a barrier, waiting processes return -1.
+int process_barrier_delete(barrierid_t id);
+/// Wait until the given number of processes are waiting, then all are
+/// released, the last one to arrive returns 1 and others return 0.
+int process_barrier_wait(barrierid_t id);
+/// Reset the barrier, waiting processes return -1.
+int process_barrier_reset(barrierid_t id);
+
+/// Create a shared memory object of the given size in bytes, its 
+/// content is zeroed.
+shmid_t process_shm_create(int size);
+/// Attach a shared memory object to the current process, returning 
+/// its user address, the address is the same for all processes.
+void *process_shm_attach(shmid_t id);
+/// Detach a shared memory object from the current process, given the
+/// address returned by 'process_shm_attach'.
+int process_shm_detach(void *addr);
+/// Destroy a shared memory object, its ID becomes invalid but its
+/// memory is only freed when detached by all processes.
+int process_shm_destroy(shmid_t id);
+
+/// Register the submission and completion rings of the current
+/// process, null unregisters them. Entries must be a power of two.
+int process_ring_setup(struct syscall_ring *ring);
+/// Execute at most count entries of the submission ring in order, and
+/// post their results to the completion ring. Execution stops early if
+/// the completion ring is full. Entries never block, syscalls that
+/// may block complete with 'SYSCALL_WOULD_BLOCK' instead, or with -1
+/// if they have no non-blocking form (waiting for any source, futex,
+/// many, call, topic, datagram, condition and barrier). Returns the
+/// number of consumed entries, or -1 if no valid ring is registered.
+int process_ring_submit(int count);
+
+/// Block the current process while the value at the given user 
+/// address is equal to the expected one, until woken up or until the
+/// given clock is reached (0 for no timeout). Returns 0 if woken up,
+/// 'SYSCALL_WOULD_BLOCK' if the value differs or on timeout.
+int process_futex_wait(const int *addr, int expected, uint32_t clock);
+/// Wake up at most count processes waiting on the given user address,
+/// in priority order, returning the number of processes woken up.
+int process_futex_wake(const int *addr, int count);
+
+/// Wait until any of the given sources is ready, returning its index,
+/// or -1 if any source is invalid.
+int process_wait_any(const struct wait_source *sources, int count);
+
 /// Pause the current process waiting for reading the console.
 int process_wait_cons_read(char *dst, size_t len);
 
 /// Create a message queue with the given capacity of messages.
 qid_t process_queue_create(int capacity);
+/// Create a queue of given capacity where messages have a priority
+/// between 0 and levels - 1 (at most 32), receiving always returns the
+/// oldest message of the highest priority.
+qid_t process_queue_create_prio(int capacity, int levels);
 /// Delete a queue from its ID.
 int process_queue_delete(qid_t qid);
 /// Send a message to a queue of given ID.
 int process_queue_send(qid_t qid, int message);
+/// Send a message with the given priority to a queue, FIFO queues only
+/// accept the priority 0.
+int process_queue_send_prio(qid_t qid, int message, int priority);
 /// Receive a message from a queue of given ID.
 int process_queue_receive(qid_t qid, int *message);
+/// Send a message to a queue of given ID, blocking at most until the
+/// given clock. Returns 'SYSCALL_WOULD_BLOCK' if the clock is reached,
+/// so a clock of 0 never blocks.
+int process_queue_send_timed(qid_t qid, int message, uint32_t clock);
+/// Receive a message from a queue of given ID, blocking at most until
+/// the given clock, see 'process_queue_send_timed'.
+int process_queue_receive_timed(qid_t qid, int *message, uint32_t clock);
+/// Send many messages to a queue of given ID, as if sent one by one,
+/// blocking while the queue is full. Returns the number of messages
+/// sent, which is less than count if the queue is deleted or reset
+/// meanwhile, or -1 if none was sent.
+int process_queue_send_many(qid_t qid, const int *messages, int count);
+/// Receive up to count messages from a queue of given ID, blocking 
+/// until at least min_count have been received, returning the number
+/// of messages received. Less than min_count are returned if the
+/// queue is deleted or reset meanwhile, or -1 if none was received.
+int process_queue_receive_many(qid_t qid, int *messages, int count, int min_count);
 /// Count waiting processes and messages on a queue of given ID.
 int process_queue_count(qid_t qid, int *count);
+/// Send a message to a queue of given ID and block until a server
+/// replies, the reply is written to the given pointer if not null. If
+/// a server is waiting with 'process_queue_receive_call', the kernel
+/// directly switches to it. Calls are independent of messages sent
+/// with 'process_queue_send'.
+int process_queue_call(qid_t qid, int message, int *reply);
+/// Receive a call on a queue of given ID, blocking until a process
+/// calls. The PID of the caller is returned, it must be given to
+/// 'process_queue_reply'.
+pid_t process_queue_receive_call(qid_t qid, int *message);
+/// Reply to a call received by the current process, the caller is
+/// directly switched to.
+int process_queue_reply(pid_t pid, int message);
+/// Change the capacity of a queue without losing or reordering its
+/// messages, the new capacity can't be less than the number of
+/// messages in the queue. If processes were blocked on a full queue,
+/// their messages are moved to the new space, in priority order.
+int process_queue_resize(qid_t qid, int capacity);
 /// Remove all messages from a queue of given ID.
 int process_queue_reset(qid_t qid);
 
+/// Create a broadcast topic, each subscriber gets a private queue of
+/// the given capacity, the policy gives what to do when publishing to
+/// a full queue (see 'enum topic_overflow').
+tid_t process_topic_create(int capacity, int policy);
+/// Delete a topic, the queues of its subscribers are deleted.
+int process_topic_delete(tid_t tid);
+/// Subscribe to a topic, returning the ID of a new queue receiving the
+/// published messages.
+qid_t process_topic_subscribe(tid_t tid);
+/// Unsubscribe from a topic, the queue is deleted.
+int process_topic_unsubscribe(tid_t tid, qid_t qid);
+/// Publish a message to all subscribers of a topic, in a single call.
+int process_topic_publish(tid_t tid, int message);
+/// Return the number of messages dropped for the subscriber queue of
+/// given ID, or for all subscribers if the queue ID is negative.
+int process_topic_drops(tid_t tid, qid_t qid);
+
+/// Create a datagram queue with a ring of the given capacity in bytes,
+/// each datagram takes 4 more bytes than its payload in the ring. The
+/// maximum payload size must fit in the ring.
+did_t process_dgram_create(int capacity, int max_size);
+/// Delete a datagram queue from its ID.
+int process_dgram_delete(did_t did);
+/// Send a datagram to a datagram queue of given ID.
+int process_dgram_send(did_t did, const void *data, int size);
+/// Receive a datagram from a datagram queue of given ID. The payload
+/// is truncated if larger than the buffer, the full size of the 
+/// datagram is returned.
+int process_dgram_receive(did_t did, void *data, int size);
+/// Count waiting processes and datagrams on a datagram queue of given
+/// ID, with the same convention as queues, and the bytes used.
+int process_dgram_count(did_t did, int *count, int *used);
+/// Remove all datagrams from a datagram queue of given ID.
+int process_dgram_reset(did_t did);
+
 /// Check that the current process has the right to access the given
 /// pointer.
 bool process_check_user_ptr(const void *ptr);
+/// Check that the current process has the right to access the whole
+/// given range, user space is checked at once and pages of the user
+/// mapping window one by one.
+bool process_check_user_range(const void *ptr, size_t size);
+/// Same as 'process_check_user_range' for an array, also rejecting
+/// sizes that overflow.
+bool process_check_user_array(const void *ptr, size_t count, size_t elem_size);
+
+/// Copy from user memory after checking the whole source range,
+/// returning -1 if invalid.
+int copy_from_user(void *dst, const void *src, size_t size);
+/// Copy to user memory after checking the whole destination range,
+/// returning -1 if invalid.
+int copy_to_user(void *dst, const void *src, size_t size);
+/// Copy a user string of at most size bytes including the terminator,
+/// each page span is checked once then copied with 'memccpy'. The copy
+/// is truncated and always terminated, its length is returned, or -1
+/// if invalid.
+int strncpy_from_user(char *dst, const char *src, size_t size);
 
 #endif
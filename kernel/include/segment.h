@@ -9,6 +9,12 @@
 #define KERNEL_CS	0x10
 /// Segment 3 in GDT (RPL = 0), data.
 #define KERNEL_DS	0x18
+/// Segment 4 in GDT (RPL = 3), code, same as 'USER_CS' but placed
+/// where SYSEXIT expects it (KERNEL_CS + 16).
+#define SYSEXIT_USER_CS	0x23
+/// Segment 5 in GDT (RPL = 3), data, same as 'USER_DS' but placed
+/// where SYSEXIT expects it (KERNEL_CS + 24).
+#define SYSEXIT_USER_DS	0x2b
 /// Segment 8 in GDT (RPL = 3), code.
 #define USER_CS		0x43
 /// Segment 9 in GDT (RPL = 3), data.
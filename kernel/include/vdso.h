@@ -0,0 +1,21 @@
+/// Page of kernel data mapped read-only in user space, so that users
+/// can read the clock and their PID without a syscall.
+
+#ifndef __VDSO_H__
+#define __VDSO_H__
+
+#include "syscall_shared.h"
+#include "stdint.h"
+
+
+/// Initialize the page and map it in the user mapping window, this
+/// must be called after 'pit_init'.
+void vdso_init(void);
+/// Update the clock, called on each tick.
+void vdso_set_clock(uint32_t clock);
+/// Update the PID of the running process, called on context switch.
+void vdso_set_pid(int pid);
+/// Return the user address of the page, null if it couldn't be mapped.
+const struct vdso_data *vdso_user_data(void);
+
+#endif
@@ -4,12 +4,13 @@
 #include "stdio.h"
 
 
-void *kalloc(size_t size) {
+/// Internal function to allocate from the right tier.
+static void *kalloc_tier(size_t size) {
 
     if (size <= 0)
         return NULL;
 
-    
+
     if (size >= LARGEALLOC)
 	    return kalloc_large(size);
     else if (size <= SMALLALLOC)
@@ -19,7 +20,8 @@ void *kalloc(size_t size) {
 
 }
 
-void kfree(void *ptr) {
+/// Internal function to free a pointer to the right tier.
+static void kfree_tier(void *ptr) {
 
     struct mem_alloc a;
 
@@ -37,6 +39,57 @@ void kfree(void *ptr) {
         case MEM_LARGE:
             kfree_large(a);
             break;
+        case MEM_ALIGNED:
+            // The pointer is the user pointer of the real allocation.
+            kfree_tier(a.ptr);
+            break;
+    }
+
+}
+
+void *kalloc(size_t size) {
+    void *ptr = kalloc_tier(size);
+#if MEM_TRACE
+    mem_trace_add(ptr, size, __builtin_return_address(0));
+#endif
+    return ptr;
+}
+
+void *kalloc_aligned(size_t size, size_t align) {
+
+    if (size == 0 || align == 0 || (align & (align - 1)) != 0)
+        return NULL;
+
+    void *ptr;
+
+    if (align <= MARK_USER_OFFSET) {
+        // All tiers already give pointers with this alignment.
+        ptr = kalloc_tier(size);
+    } else {
+
+        // See 'mem_mark_aligned' for the required size. Because all tiers
+        // round up their allocations (fixed chunk, power of two or pages)
+        // the extra space is often already available for free.
+        size_t inner_size;
+        if (__builtin_add_overflow(size, align - MARK_USER_OFFSET, &inner_size))
+            return NULL;
+
+        ptr = kalloc_tier(inner_size);
+        if (ptr != NULL)
+            ptr = mem_mark_aligned(ptr, align);
+
     }
 
+#if MEM_TRACE
+    mem_trace_add(ptr, size, __builtin_return_address(0));
+#endif
+    return ptr;
+
+}
+
+void kfree(void *ptr) {
+#if MEM_TRACE
+    mem_trace_remove(ptr);
+#endif
+    kfree_tier(ptr);
 }
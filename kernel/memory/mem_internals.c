@@ -46,6 +46,22 @@ bool mem_mark_check(void *ptr, struct mem_alloc *a) {
     size_t size = ptr_head[0];
     size_t magic = ptr_head[1];
 
+    if ((magic & 0b11) == MEM_ALIGNED) {
+
+        // Aligned marks have no tail, the magic must be exactly the
+        // hash of the head, and the size is the offset to the user
+        // pointer of the underlying allocation.
+        if (magic != ((hash_ptr(ptr_head) & ~((size_t) 0b11)) | MEM_ALIGNED)) {
+            return false;
+        }
+
+        a->ptr = ptr - size;
+        a->kind = MEM_ALIGNED;
+        a->size = size;
+        return true;
+
+    }
+
     size_t *ptr_tail = (size_t*) ((size_t) ptr_head + size - MARK_USER_OFFSET);
     // assert(ptr_tail[0] == magic);
     // assert(ptr_tail[1] == size);
@@ -63,6 +79,25 @@ bool mem_mark_check(void *ptr, struct mem_alloc *a) {
 }
 
 
+/// Place an aligned pointer inside the given user pointer, returned
+/// by one of the tiers, and mark its head so it can be freed later.
+/// 
+/// All tiers give user pointers that are 'MARK_USER_OFFSET' after a
+/// 'MARK_SIZE' aligned chunk, therefore the caller must have
+/// allocated at least 'size + align - MARK_USER_OFFSET' bytes.
+void *mem_mark_aligned(void *ptr, size_t align) {
+
+    size_t aligned = ((size_t) ptr + MARK_USER_OFFSET + align - 1) & ~(align - 1);
+
+    size_t *ptr_head = (size_t *) (aligned - MARK_USER_OFFSET);
+    ptr_head[0] = aligned - (size_t) ptr;
+    ptr_head[1] = (hash_ptr(ptr_head) & ~((size_t) 0b11)) | MEM_ALIGNED;
+
+    return (void *) aligned;
+
+}
+
+
 size_t mem_realloc_small() {
 
     // assert(arena.chunkpool == 0);
@@ -7,6 +7,12 @@
 #include "stdint.h"
 #include "stddef.h"
 
+// Allocation-site tracking, see 'mem_trace.c', can be enabled with
+// 'make MEM_TRACE=1'.
+#ifndef MEM_TRACE
+#define MEM_TRACE 0
+#endif
+
 // 2 MAGIC + 2 sizes
 #define MARK_SIZE (sizeof(size_t) * 4)
 #define MARK_USER_OFFSET (MARK_SIZE / 2)
@@ -25,7 +31,10 @@
 #define TZL_SIZE 48
 
 
-enum mem_kind { MEM_SMALL, MEM_MEDIUM, MEM_LARGE };
+/// Kind of allocation, stored in the two low bits of the magic. The
+/// aligned kind is not a tier by itself, it's a short head mark put
+/// in front of an aligned pointer inside a larger allocation.
+enum mem_kind { MEM_SMALL, MEM_MEDIUM, MEM_LARGE, MEM_ALIGNED };
 
 struct mem_alloc {
     void *ptr;
@@ -44,6 +53,7 @@ extern struct mem_arena arena;
 
 void *mem_mark_and_get_user_ptr(void *ptr, size_t size, enum mem_kind kind);
 bool mem_mark_check(void *ptr, struct mem_alloc *a);
+void *mem_mark_aligned(void *ptr, size_t align);
 
 size_t mem_realloc_small();
 size_t mem_realloc_medium();
@@ -56,4 +66,9 @@ void kfree_small(struct mem_alloc a);
 void kfree_medium(struct mem_alloc a);
 void kfree_large(struct mem_alloc a);
 
+#if MEM_TRACE
+void mem_trace_add(void *ptr, size_t size, void *site);
+void mem_trace_remove(void *ptr);
+#endif
+
 #endif
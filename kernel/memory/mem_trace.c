@@ -0,0 +1,204 @@
+/// Allocation-site tracking for the kernel allocator, only compiled
+/// when 'MEM_TRACE' is enabled. Each live allocation is recorded in a
+/// side table keyed by pointer (open addressing, linear probing), with
+/// the return address of the 'kalloc' caller and the requested size.
+
+#include "memory.h"
+#include "process.h"
+#include "mem_internals.h"
+
+#include "stdint.h"
+#include "stddef.h"
+#include "string.h"
+
+
+#if MEM_TRACE
+
+// Must be a power of two.
+#define MEM_TRACE_CAP 4096
+// Maximum number of distinct call sites reported by the dump.
+#define MEM_TRACE_SITES_CAP 64
+
+
+struct mem_trace_entry {
+    /// User pointer of the allocation, null if the entry is free.
+    void *ptr;
+    /// Return address of the 'kalloc' caller.
+    void *site;
+    /// Requested allocation size.
+    size_t size;
+};
+
+/// The table is allocated directly from pages on first use, so that
+/// it doesn't interfere with the allocator it's tracking.
+static struct mem_trace_entry *trace_table = NULL;
+static bool trace_table_failed = false;
+static size_t trace_count = 0;
+static size_t trace_dropped = 0;
+
+/// Static because kernel stacks are too small for it, one more for
+/// the sum of remaining sites.
+static struct mem_trace_site trace_sites[MEM_TRACE_SITES_CAP + 1];
+
+
+static size_t mem_trace_hash(void *ptr) {
+    return (((size_t) ptr >> 3) * 2654435761u) & (MEM_TRACE_CAP - 1);
+}
+
+static bool mem_trace_init(void) {
+
+    if (trace_table != NULL)
+        return true;
+    if (trace_table_failed)
+        return false;
+
+    size_t table_size = sizeof(struct mem_trace_entry) * MEM_TRACE_CAP;
+    trace_table = page_alloc(table_size);
+    if (trace_table == NULL) {
+        trace_table_failed = true;
+        return false;
+    }
+
+    memset(trace_table, 0, table_size);
+    return true;
+
+}
+
+void mem_trace_add(void *ptr, size_t size, void *site) {
+
+    if (ptr == NULL || !mem_trace_init())
+        return;
+
+    // Keep at least one free entry so that probing always terminates.
+    if (trace_count >= MEM_TRACE_CAP - 1) {
+        trace_dropped++;
+        return;
+    }
+
+    size_t index = mem_trace_hash(ptr);
+    while (trace_table[index].ptr != NULL)
+        index = (index + 1) & (MEM_TRACE_CAP - 1);
+
+    trace_table[index].ptr = ptr;
+    trace_table[index].site = site;
+    trace_table[index].size = size;
+    trace_count++;
+
+}
+
+void mem_trace_remove(void *ptr) {
+
+    if (ptr == NULL || trace_table == NULL)
+        return;
+
+    size_t index = mem_trace_hash(ptr);
+    while (trace_table[index].ptr != ptr) {
+        if (trace_table[index].ptr == NULL)
+            return; // Not tracked, probably dropped.
+        index = (index + 1) & (MEM_TRACE_CAP - 1);
+    }
+
+    // Backward shift deletion: move following entries of the cluster
+    // into the hole if their home slot allows it, so that we never
+    // need tombstones.
+    size_t hole = index;
+    size_t next = (hole + 1) & (MEM_TRACE_CAP - 1);
+    while (trace_table[next].ptr != NULL) {
+        size_t home = mem_trace_hash(trace_table[next].ptr);
+        // Distance from home must cover the hole for the entry to move.
+        if (((next - home) & (MEM_TRACE_CAP - 1)) >= ((next - hole) & (MEM_TRACE_CAP - 1))) {
+            trace_table[hole] = trace_table[next];
+            hole = next;
+        }
+        next = (next + 1) & (MEM_TRACE_CAP - 1);
+    }
+
+    trace_table[hole].ptr = NULL;
+    trace_count--;
+
+}
+
+int mem_trace_sites(struct mem_trace_site *sites, int count) {
+
+    if (sites != NULL && count < 0)
+        return -1;
+
+    size_t sites_count = 0;
+    struct mem_trace_site other = { 0, trace_dropped, 0 };
+
+    for (size_t i = 0; trace_table != NULL && i < MEM_TRACE_CAP; i++) {
+
+        struct mem_trace_entry *entry = &trace_table[i];
+        if (entry->ptr == NULL)
+            continue;
+
+        size_t j = 0;
+        while (j < sites_count && trace_sites[j].site != (size_t) entry->site)
+            j++;
+
+        if (j == sites_count) {
+            if (sites_count == MEM_TRACE_SITES_CAP) {
+                other.count++;
+                other.bytes += entry->size;
+                continue;
+            }
+            trace_sites[j].site = (size_t) entry->site;
+            trace_sites[j].count = 0;
+            trace_sites[j].bytes = 0;
+            sites_count++;
+        }
+
+        trace_sites[j].count++;
+        trace_sites[j].bytes += entry->size;
+
+    }
+
+    // Insertion sort by decreasing bytes, there are few sites.
+    for (size_t i = 1; i < sites_count; i++) {
+        struct mem_trace_site site = trace_sites[i];
+        size_t j = i;
+        while (j > 0 && trace_sites[j - 1].bytes < site.bytes) {
+            trace_sites[j] = trace_sites[j - 1];
+            j--;
+        }
+        trace_sites[j] = site;
+    }
+
+    // Sites beyond our capacity and untracked allocations are summed
+    // in a last entry with a null site.
+    if (other.count != 0) {
+        trace_sites[sites_count++] = other;
+    }
+
+    if (sites == NULL)
+        return sites_count;
+
+    if (sites_count > (size_t) count) {
+        // Sum the sites that don't fit in the last entry of the array.
+        if (count > 0) {
+            struct mem_trace_site *last = &trace_sites[count - 1];
+            last->site = 0;
+            for (size_t i = count; i < sites_count; i++) {
+                last->count += trace_sites[i].count;
+                last->bytes += trace_sites[i].bytes;
+            }
+        }
+        sites_count = count;
+    }
+
+    if (copy_to_user(sites, trace_sites, sites_count * sizeof(struct mem_trace_site)))
+        return -1;
+
+    return sites_count;
+
+}
+
+#else
+
+int mem_trace_sites(struct mem_trace_site *sites, int count) {
+    (void) sites;
+    (void) count;
+    return -1;
+}
+
+#endif
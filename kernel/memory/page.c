@@ -139,13 +139,13 @@ void page_free(void *ptr, size_t size) {
     size_t page_offset = ptr - ((void *) &mem_heap);
     size_t page_index = page_offset / PAGE_SIZE;
 
+    alloc_count -= count;
+
     while (count != 0) {
         page_set_allocated(page_index++, false);
         count--;
     }
 
-    alloc_count -= count;
-
 }
 
 size_t page_capacity(void) {
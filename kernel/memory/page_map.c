@@ -0,0 +1,105 @@
+/// Mapping of kernel pages in a user-accessible window, after the end
+/// of user space. The window is covered by a single page table that
+/// is installed in the page directory on first use.
+
+#include "memory.h"
+
+#include "stdint.h"
+#include "string.h"
+#include "stdio.h"
+
+// Symbols defined in kernel.lds
+extern char user_map_start;
+extern char user_map_end;
+// Page directory defined in crt0.S
+extern uint32_t pgdir[];
+
+#define PAGE_PRESENT    0x1
+#define PAGE_WRITE      0x2
+#define PAGE_USER       0x4
+
+#define MAP_PAGE_COUNT  1024
+
+static uint32_t map_pgtab[MAP_PAGE_COUNT] __attribute__((aligned(PAGE_SIZE)));
+static bool map_pgtab_installed = false;
+
+
+static size_t page_map_count(size_t size) {
+    return (size - 1) / PAGE_SIZE + 1;
+}
+
+static void page_map_invalidate(void *addr) {
+    __asm__ __volatile__("invlpg (%0)" :: "r" (addr) : "memory");
+}
+
+/// Map pages with the given page table flags, in addition to present
+/// and user.
+static void *page_map_user_flags(void *ptr, size_t size, uint32_t flags) {
+
+    assert(((uint32_t) ptr & (PAGE_SIZE - 1)) == 0);
+    assert(size > 0);
+
+    if (!map_pgtab_installed) {
+        memset(map_pgtab, 0, sizeof(map_pgtab));
+        pgdir[(uint32_t) &user_map_start >> 22] = (uint32_t) map_pgtab | PAGE_USER | PAGE_WRITE | PAGE_PRESENT;
+        map_pgtab_installed = true;
+    }
+
+    size_t count = page_map_count(size);
+    size_t window_count = (&user_map_end - &user_map_start) / PAGE_SIZE;
+
+    // First fit on free page table entries.
+    size_t run = 0;
+    for (size_t index = 0; index < window_count; index++) {
+
+        if (map_pgtab[index] != 0) {
+            run = 0;
+            continue;
+        }
+
+        if (++run == count) {
+
+            size_t first = index + 1 - count;
+            for (size_t i = 0; i < count; i++) {
+                map_pgtab[first + i] = ((uint32_t) ptr + i * PAGE_SIZE) | flags | PAGE_USER | PAGE_PRESENT;
+            }
+
+            // Entries were not present, so nothing to invalidate.
+            return &user_map_start + first * PAGE_SIZE;
+
+        }
+
+    }
+
+    return NULL;
+
+}
+
+void *page_map_user(void *ptr, size_t size) {
+    return page_map_user_flags(ptr, size, PAGE_WRITE);
+}
+
+void *page_map_user_read_only(void *ptr, size_t size) {
+    return page_map_user_flags(ptr, size, 0);
+}
+
+void page_unmap_user(void *addr, size_t size) {
+
+    size_t first = ((char *) addr - &user_map_start) / PAGE_SIZE;
+    assert((char *) addr >= &user_map_start && map_pgtab[first] != 0);
+    size_t count = page_map_count(size);
+
+    for (size_t i = 0; i < count; i++) {
+        map_pgtab[first + i] = 0;
+        page_map_invalidate(addr + i * PAGE_SIZE);
+    }
+
+}
+
+bool page_user_mapped(const void *ptr) {
+    if ((char *) ptr < &user_map_start || (char *) ptr >= &user_map_end)
+        return false;
+    // Read-only pages are rejected, the kernel ignores the protection
+    // when writing to them on behalf of a syscall.
+    return (map_pgtab[((char *) ptr - &user_map_start) / PAGE_SIZE] & PAGE_WRITE) != 0;
+}
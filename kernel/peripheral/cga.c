@@ -6,30 +6,92 @@
 #include "cga.h"
 
 #define CGA_CMD             0x03D4
+#define CGA_CMD_START_HI    0x0C
+#define CGA_CMD_START_LO    0x0D
 #define CGA_CMD_CURSOR_LO   0x0F
 #define CGA_CMD_CURSOR_HI   0x0E
 #define CGA_DATA            0x03D5
 
+/// Number of whole lines in the 32 KiB text plane.
+#define CGA_PLANE_LINES     (0x8000 / (CGA_COLS * 2))
+#define CGA_ALL_LINES       ((1 << CGA_ROWS) - 1)
+/// Lines kept in the shadow buffer, the screen and the scrollback
+/// history, must be a power of two.
+#define CGA_HISTORY_LINES   4096
+
 
 static uint32_t line_ = 0;
 static uint32_t column_ = 0;
 
-
-/// This function get the pointer to the character at given position.
+/// Characters are written to a shadow buffer in RAM, lines that
+/// changed are copied to video memory by 'cga_flush', because video
+/// memory is slow to access, especially under emulation. The shadow
+/// buffer is a ring of lines, so that scrolling moves nothing, and
+/// lines that scroll out of the screen are kept as history.
+static uint16_t shadow[CGA_HISTORY_LINES][CGA_COLS];
+/// Number of lines scrolled since startup, this is the first line of
+/// the screen, its index in the ring is taken modulo the ring size.
+static uint32_t shadow_top = 0;
+/// Number of lines the view is scrolled back in the history, zero if
+/// the view shows the screen.
+static uint32_t view_back = 0;
+/// One bit per line of the view, set if the line changed.
+static uint32_t shadow_dirty = 0;
+/// True if the cursor changed since the last flush.
+static bool cursor_dirty = true;
+
+/// Video memory is also used as a circular window, the screen shows
+/// the lines starting at this origin, which is moved by the CRT
+/// controller start address to scroll.
+static uint32_t origin = 0;
+/// True if the origin changed since the last flush.
+static bool origin_dirty = true;
+
+
+/// This function get the pointer to the character at given position
+/// in video memory.
 static inline uint16_t *char_pointer(uint32_t line, uint32_t column) {
-    return (uint16_t *) 0xB8000 + (line * 80 + column);
+    return (uint16_t *) 0xB8000 + ((origin + line) * 80 + column);
+}
+
+/// Get a line of the shadow buffer, relative to the first line of the
+/// screen, negative for the history.
+static inline uint16_t *shadow_line(int32_t line) {
+    return shadow[(shadow_top + line) & (CGA_HISTORY_LINES - 1)];
+}
+
+/// Mark a line of the screen as dirty, if it's visible in the view.
+static inline void shadow_mark(uint32_t line) {
+    line += view_back;
+    if (line < CGA_ROWS)
+        shadow_dirty |= 1 << line;
+}
+
+/// Return the maximum number of lines the view can be scrolled back.
+static uint32_t view_back_max(void) {
+    uint32_t max = CGA_HISTORY_LINES - CGA_ROWS;
+    return shadow_top < max ? shadow_top : max;
+}
+
+/// Write a word to a register of the CRT controller.
+static void cga_crtc_write(uint8_t reg_hi, uint8_t reg_lo, uint16_t value) {
+    outb(reg_lo, CGA_CMD);
+    outb((uint8_t) (value & 0xFF), CGA_DATA);
+    outb(reg_hi, CGA_CMD);
+    outb((uint8_t) ((value >> 8) & 0xFF), CGA_DATA);
 }
 
 
 void cga_char(uint32_t line, uint32_t column, char *ch, enum cga_color *fg, enum cga_color *bg) {
-    uint16_t data = *char_pointer(line, column);
+    uint16_t data = shadow_line(line)[column];
     *ch = data & 0xFF;
     *fg = (data >> 8) & 0b1111;
     *bg = (data >> 12) & 0b111;
 }
 
 void cga_set_char(uint32_t line, uint32_t column, char ch, enum cga_color fg, enum cga_color bg) {
-    *char_pointer(line, column) = ((fg & 0b1111) << 8) | ((bg & 0b111) << 12) | ((uint16_t) ch);
+    shadow_line(line)[column] = ((fg & 0b1111) << 8) | ((bg & 0b111) << 12) | ((uint16_t) ch);
+    shadow_mark(line);
 }
 
 void cga_cursor(uint32_t *line, uint32_t *column) {
@@ -38,35 +100,102 @@ void cga_cursor(uint32_t *line, uint32_t *column) {
 }
 
 void cga_set_cursor(uint32_t line, uint32_t column) {
+    if (line != line_ || column != column_) {
+        line_ = line;
+        column_ = column;
+        cursor_dirty = true;
+    }
+}
+
+void cga_clear(void) {
+    uint16_t *first = shadow_line(0);
+    for (size_t i = 0; i < CGA_COLS; i++)
+        first[i] = (0b00001111 << 8) | ' ';
+    for (size_t line = 1; line < CGA_ROWS; line++) {
+        memcpy(shadow_line(line), first, sizeof(shadow[0]));
+        shadow_mark(line);
+    }
+    shadow_mark(0);
+}
+
+void cga_scroll_down(void) {
 
-    line_ = line;
-    column_ = column;
+    // The oldest line of the history becomes the last one of the
+    // screen.
+    memset(shadow_line(CGA_ROWS), 0, sizeof(shadow[0]));
+    shadow_top++;
+
+    if (view_back != 0) {
+        // The view stays on the same lines, so nothing changes on
+        // screen, unless they are dropped from the history.
+        if (view_back < view_back_max()) {
+            view_back++;
+        } else {
+            shadow_dirty = CGA_ALL_LINES;
+        }
+        return;
+    }
+
+    shadow_dirty = (shadow_dirty >> 1) | (1 << (CGA_ROWS - 1));
 
-    uint16_t index = column + line * 80;
-    outb(CGA_CMD_CURSOR_LO, CGA_CMD);
-    outb((uint8_t) (index & 0xFFFF), CGA_DATA);
-    outb(CGA_CMD_CURSOR_HI, CGA_CMD);
-    outb((uint8_t) ((index >> 8) & 0xFFFF), CGA_DATA);
+    // The cursor is given relative to the origin.
+    origin++;
+    origin_dirty = true;
+    cursor_dirty = true;
+
+    // Only copy when the window reaches the end of the text plane.
+    if (origin + CGA_ROWS > CGA_PLANE_LINES) {
+        origin = 0;
+        shadow_dirty = CGA_ALL_LINES;
+    }
 
 }
 
-void cga_clear(void) {
-    uint8_t *ptr = (uint8_t *) 0xB8000;
-    while (ptr < (uint8_t *) (0xB8000 + (CGA_COLS * CGA_ROWS * 2))) {
-        *ptr = ' ';
-        ptr++;
-        *ptr = 0b00001111;
-        ptr++;
+void cga_scroll_view(int32_t lines) {
+
+    int32_t back = (int32_t) view_back + lines;
+    if (back < 0)
+        back = 0;
+    if ((uint32_t) back > view_back_max())
+        back = view_back_max();
+
+    if ((uint32_t) back != view_back) {
+        view_back = back;
+        shadow_dirty = CGA_ALL_LINES;
+        cursor_dirty = true;
     }
+
 }
 
-void cga_scroll_down(void) {
-    
-    uint8_t *first_line = (uint8_t *) 0xB8000;
-    uint8_t *second_line = (uint8_t *) (0xB8000 + 160);
-    uint8_t *last_line = (uint8_t *) (0xB8000 + 4000 - 160);
+void cga_view_reset(void) {
+    cga_scroll_view(-(int32_t) view_back);
+}
+
+void cga_flush(void) {
 
-    memmove(first_line, second_line, 4000 - 160);
-    memset(last_line, 0, 160);
+    // 'memcpy' moves double words with 'rep movsl'.
+    for (uint32_t line = 0; shadow_dirty != 0; line++) {
+        if ((shadow_dirty & (1 << line)) != 0) {
+            memcpy(char_pointer(line, 0), shadow_line((int32_t) line - (int32_t) view_back), sizeof(shadow[0]));
+            shadow_dirty &= ~(1 << line);
+        }
+    }
+
+    if (origin_dirty) {
+        cga_crtc_write(CGA_CMD_START_HI, CGA_CMD_START_LO, origin * CGA_COLS);
+        origin_dirty = false;
+    }
+
+    if (cursor_dirty) {
+        // Hidden below the screen while viewing the history.
+        uint32_t line = view_back == 0 ? line_ : CGA_ROWS;
+        uint32_t column = view_back == 0 ? column_ : 0;
+        cga_crtc_write(CGA_CMD_CURSOR_HI, CGA_CMD_CURSOR_LO, (origin + line) * CGA_COLS + column);
+        cursor_dirty = false;
+    }
+
+}
 
+void *cga_screen_base(void) {
+    return char_pointer(0, 0);
 }
@@ -9,6 +9,7 @@
 #include "memory.h"
 #include "cons.h"
 #include "cga.h"
+#include "process.h"
 
 
 // Variables related to writing a formatted character at particular
@@ -20,19 +21,35 @@ static uint32_t write_column = 0;
 static bool write_escape = false;
 static bool write_escape_bg = false;
 
-#define ALL_BUFFER_CAP 2048
-static char all_buffer[ALL_BUFFER_CAP];
-static size_t all_buffer_len = 0;
+/// Completed lines waiting to be read are stored in a ring, indices
+/// are free-running and taken modulo the capacity. Each line is
+/// followed by a line break, and the position of each line break is
+/// kept in a second ring, so that readers never scan for it. Both
+/// capacities must be powers of two.
+#define INPUT_CAP 2048
+#define INPUT_LINES_CAP 256
+static char input_ring[INPUT_CAP];
+static size_t input_head = 0;
+static size_t input_tail = 0;
+static size_t input_line_ends[INPUT_LINES_CAP];
+static size_t input_lines_head = 0;
+static size_t input_lines_tail = 0;
 
 static cons_wake_t wake_func = NULL;
 
+/// The line being edited is a gap buffer, characters before the
+/// cursor are at the start of the buffer and characters after it are
+/// at the end, so that editing at the cursor moves nothing.
 #define LINE_BUFFER_CAP 1024
 static char line_buffer[LINE_BUFFER_CAP];
-static size_t line_buffer_len = 0;
 static size_t line_buffer_cursor = 0;
+static size_t line_buffer_after = LINE_BUFFER_CAP;
 static size_t line_buffer_line = 0;
 static size_t line_buffer_column = 0;
 static bool line_buffer_insert = true;
+/// True if output moved the line being edited, it must be redrawn
+/// entirely on the next edit.
+static bool line_buffer_stale = false;
 
 /// True if the input keyboard should be echo-ed to the display.
 static bool echo_ = true;
@@ -107,46 +124,120 @@ static void cons_write_char(char ch) {
 
 }
 
-/// Echo the line buffer if needed.
-static void cons_echo_line_buffer(void) {
+/// Return the length of the line buffer.
+static inline size_t cons_line_len(void) {
+    return line_buffer_cursor + (LINE_BUFFER_CAP - line_buffer_after);
+}
+
+/// Get the screen position of a character of the line buffer, all
+/// characters of the line are printable so they take one cell.
+static void cons_line_position(size_t index, uint32_t *line, uint32_t *column) {
+    size_t position = line_buffer_column + index;
+    *line = line_buffer_line + position / CGA_COLS;
+    *column = position % CGA_COLS;
+}
+
+static void cons_echo_line_buffer(size_t from, size_t to, size_t erase);
+
+/// Move the screen cursor to the cursor of the line buffer, if echo
+/// is enabled. The view is scrolled back to the screen to show the
+/// line being edited.
+static void cons_echo_cursor(void) {
+
+    if (line_buffer_stale) {
+        line_buffer_stale = false;
+        cons_echo_line_buffer(0, cons_line_len(), 0);
+        return;
+    }
 
     if (echo_) {
+        uint32_t line, column;
+        cons_line_position(line_buffer_cursor, &line, &column);
+        cga_view_reset();
+        cga_set_cursor(line, column);
+        cga_flush();
+    }
+
+}
 
-        write_line = line_buffer_line;
-        write_column = line_buffer_column;
+/// Echo the characters of the line buffer in the given range, if
+/// echo is enabled, followed by the given number of blanks to erase
+/// characters that were removed. The whole line is echoed if output
+/// moved it.
+static void cons_echo_line_buffer(size_t from, size_t to, size_t erase) {
 
-        if (line_buffer_cursor == 0) {
-            cga_set_cursor(write_line, write_column);
-        }
+    if (line_buffer_stale) {
+        line_buffer_stale = false;
+        from = 0;
+        to = cons_line_len();
+    }
+
+    if (echo_) {
+
+        cons_line_position(from, &write_line, &write_column);
 
-        for (size_t i = 0; i < line_buffer_len; i++) {
-            cons_write_char(line_buffer[i]);
-            if (i + 1 == line_buffer_cursor) {
-                cga_set_cursor(write_line, write_column);
+        for (size_t i = from; i < to; i++) {
+            if (i < line_buffer_cursor) {
+                cons_write_char(line_buffer[i]);
+            } else {
+                cons_write_char(line_buffer[i - line_buffer_cursor + line_buffer_after]);
             }
         }
 
-        cons_write_char(' ');
+        while (erase-- > 0)
+            cons_write_char(' ');
+
+        // Output continues at the end of the line, also when only a
+        // part of it was echoed.
+        cons_line_position(cons_line_len(), &write_line, &write_column);
+
+        cons_echo_cursor();
 
     }
 
 }
 
-/// Flush the line buffer to the global buffer.
-static void cons_flush_line_buffer(void) {
+/// Copy bytes at the tail of the input ring, wrapping if needed.
+static void cons_input_write(const char *src, size_t len) {
+    size_t index = input_tail & (INPUT_CAP - 1);
+    size_t first = INPUT_CAP - index;
+    if (first > len)
+        first = len;
+    memcpy(input_ring + index, src, first);
+    memcpy(input_ring, src + first, len - first);
+    input_tail += len;
+}
 
-    // -1 for one line break at the end of the line.
-    size_t copy_len = ALL_BUFFER_CAP - all_buffer_len - 1;
-    if (copy_len > line_buffer_len) {
-        copy_len = line_buffer_len;
-    }
+/// Copy bytes from the head of the input ring to the reader's memory,
+/// wrapping if needed. Returns -1 if the destination is invalid.
+static int cons_input_read(char *dst, size_t len) {
+    size_t index = input_head & (INPUT_CAP - 1);
+    size_t first = INPUT_CAP - index;
+    if (first > len)
+        first = len;
+    if (copy_to_user(dst, input_ring + index, first))
+        return -1;
+    return copy_to_user(dst + first, input_ring, len - first);
+}
+
+/// Flush the line buffer to the input ring. If the ring can't take the
+/// whole line, the line is kept in the line buffer and false is
+/// returned, the user can submit it again once lines have been read.
+static bool cons_flush_line_buffer(void) {
+
+    // +1 for the line break at the end of the line.
+    if (INPUT_CAP - (input_tail - input_head) < cons_line_len() + 1)
+        return false;
+    if (input_lines_tail - input_lines_head == INPUT_LINES_CAP)
+        return false;
 
-    memcpy(all_buffer + all_buffer_len, line_buffer, copy_len);
-    all_buffer_len += copy_len;
-    all_buffer[all_buffer_len++] = '\n';
+    cons_input_write(line_buffer, line_buffer_cursor);
+    cons_input_write(line_buffer + line_buffer_after, LINE_BUFFER_CAP - line_buffer_after);
+    input_line_ends[input_lines_tail++ & (INPUT_LINES_CAP - 1)] = input_tail;
+    cons_input_write("\n", 1);
 
-    line_buffer_len = 0;
     line_buffer_cursor = 0;
+    line_buffer_after = LINE_BUFFER_CAP;
 
     if (wake_func != NULL) {
         cons_wake_t wake = wake_func;
@@ -154,6 +245,8 @@ static void cons_flush_line_buffer(void) {
         wake();
     }
 
+    return true;
+
 }
 
 /// Internal function that is triggered when a key is pressed.
@@ -167,63 +260,77 @@ static void cons_key_handler(enum keyboard_key key, uint32_t scancode, enum keyb
         switch (key) {
         case K_BACKSPACE:
             if (line_buffer_cursor > 0) {
-                
                 line_buffer_cursor--;
-                for (size_t i = line_buffer_cursor; i < line_buffer_len - 1; i++) {
-                    line_buffer[i] = line_buffer[i + 1];
-                }
-
-                line_buffer_len--;
-                cons_echo_line_buffer();
-
+                cons_echo_line_buffer(line_buffer_cursor, cons_line_len(), 1);
             }
             break;
         
         case K_DELETE:
-            if (line_buffer_cursor < line_buffer_len) {
-                for (size_t i = line_buffer_cursor; i < line_buffer_len - 1; i++) {
-                    line_buffer[i] = line_buffer[i + 1];
-                }
-                line_buffer_len--;
-                cons_echo_line_buffer();
+            if (line_buffer_after < LINE_BUFFER_CAP) {
+                line_buffer_after++;
+                cons_echo_line_buffer(line_buffer_cursor, cons_line_len(), 1);
             }
             break;
 
+        // Cursor moves transfer characters across the gap, nothing is
+        // redrawn.
+
         case K_CURSOR_LEFT:
             if (line_buffer_cursor > 0) {
-                line_buffer_cursor--;
-                cons_echo_line_buffer();
+                line_buffer[--line_buffer_after] = line_buffer[--line_buffer_cursor];
+                cons_echo_cursor();
             }
             break;
         
         case K_CURSOR_RIGHT:
-            if (line_buffer_cursor < line_buffer_len) {
-                line_buffer_cursor++;
-                cons_echo_line_buffer();
+            if (line_buffer_after < LINE_BUFFER_CAP) {
+                line_buffer[line_buffer_cursor++] = line_buffer[line_buffer_after++];
+                cons_echo_cursor();
             }
             break;
         
         case K_HOME:
+            line_buffer_after -= line_buffer_cursor;
+            memmove(line_buffer + line_buffer_after, line_buffer, line_buffer_cursor);
             line_buffer_cursor = 0;
-            cons_echo_line_buffer();
+            cons_echo_cursor();
             break;
         
         case K_END:
-            line_buffer_cursor = line_buffer_len;
-            cons_echo_line_buffer();
+            memmove(line_buffer + line_buffer_cursor, line_buffer + line_buffer_after, LINE_BUFFER_CAP - line_buffer_after);
+            line_buffer_cursor += LINE_BUFFER_CAP - line_buffer_after;
+            line_buffer_after = LINE_BUFFER_CAP;
+            cons_echo_cursor();
             break;
         
+        case K_PAGE_UP:
+            cga_scroll_view(CGA_ROWS - 1);
+            cga_flush();
+            break;
+
+        case K_PAGE_DOWN:
+            cga_scroll_view(-(CGA_ROWS - 1));
+            cga_flush();
+            break;
+
         case K_INSERT:
         case K_KP_INSERT:
             line_buffer_insert = !line_buffer_insert;
             break;
 
         case K_ENTER:
-        case K_KP_ENTER:
-            cons_flush_line_buffer();
-            if (echo_)
+        case K_KP_ENTER: {
+            // The line break is written after the end of the line.
+            uint32_t end_line, end_column;
+            cons_line_position(cons_line_len(), &end_line, &end_column);
+            if (cons_flush_line_buffer() && echo_) {
+                write_line = end_line;
+                write_column = end_column;
+                cga_view_reset();
                 cons_write("\n", 1);
+            }
             break;
+        }
 
         default:
             break;
@@ -236,33 +343,28 @@ static void cons_key_handler(enum keyboard_key key, uint32_t scancode, enum keyb
 /// Internal function that is triggered when a character is received.
 static void cons_char_handler(char ch) {
 
-    if (line_buffer_cursor < LINE_BUFFER_CAP) {
-
-        // When inserting, we need to increase move all characters
-        // to right.
-        if (line_buffer_insert) {
-
-            // Cannot insert if length is already at its maximum cap.
-            if (line_buffer_len >= LINE_BUFFER_CAP) {
-                return;
-            }
-
-            line_buffer_len++;
-            for (size_t i = line_buffer_len - 1; i > line_buffer_cursor; i--) {
-                line_buffer[i] = line_buffer[i - 1];
-            }
-
-        }
+    // Screen positions are computed assuming one cell per character.
+    if (ch < 32 || ch > 126)
+        return;
 
+    if (!line_buffer_insert && line_buffer_after < LINE_BUFFER_CAP) {
+        // Overwrite the character after the cursor, only the written
+        // character is redrawn.
+        line_buffer_after++;
         line_buffer[line_buffer_cursor++] = ch;
-
-        if (line_buffer_cursor > line_buffer_len) {
-            line_buffer_len = line_buffer_cursor;
-        }
-
+        cons_echo_line_buffer(line_buffer_cursor - 1, line_buffer_cursor, 0);
+        return;
     }
 
-    cons_echo_line_buffer();
+    // Cannot insert if the gap is empty, the line is at its maximum
+    // length.
+    if (line_buffer_cursor == line_buffer_after)
+        return;
+
+    // Characters after the cursor are shifted on screen, not in the
+    // buffer.
+    line_buffer[line_buffer_cursor++] = ch;
+    cons_echo_line_buffer(line_buffer_cursor - 1, cons_line_len(), 0);
 
 }
 
@@ -287,54 +389,55 @@ void cons_write(const char *src, size_t len) {
 
     line_buffer_line = write_line;
     line_buffer_column = write_column;
+    line_buffer_stale = cons_line_len() != 0;
 
     cga_set_cursor(write_line, write_column);
+    cga_flush();
 
 }
 
-bool cons_try_read(char *dst, size_t *len, cons_wake_t wake) {
+int cons_try_read(char *dst, size_t *len, cons_wake_t wake) {
 
     size_t max_len = *len;
 
     if (max_len == 0)
-        return true;
+        return 1;
 
-    if (all_buffer_len == 0) {
+    if (input_lines_head == input_lines_tail) {
         if (wake != NULL)
             wake_func = wake;
-        return false;
+        return 0;
     }
 
-    // Cannot get more length than available.
-    if (max_len > all_buffer_len) {
-        max_len = all_buffer_len;
-    }
+    // Length of the first line, without its line break, which is only
+    // consumed if the whole line fits.
+    size_t line_len = input_line_ends[input_lines_head & (INPUT_LINES_CAP - 1)] - input_head;
+    size_t read_len = line_len < max_len ? line_len : max_len;
 
-    // Copy each character one by one.
-    size_t read_len = 0;
-    bool read_eol = false;
+    // Nothing is consumed if the copy failed.
+    if (dst != NULL && cons_input_read(dst, read_len))
+        return -1;
 
-    for (; !read_eol && read_len < max_len; read_len++) {
-        char ch = all_buffer[read_len];
-        if (ch == '\n') {
-            read_eol = true;
-        } else if (dst != NULL) {
-            dst[read_len] = ch;
-        }
+    input_head += read_len;
+    if (line_len < max_len) {
+        input_head++;
+        input_lines_head++;
     }
 
-    all_buffer_len -= read_len;
+    *len = read_len;
+    return 1;
+
+}
 
-    // Remove the read part.
-    for (size_t j = 0; j < all_buffer_len; j++) {
-        all_buffer[j] = all_buffer[j + read_len];
-    }
+bool cons_poll(cons_wake_t wake) {
 
-    if (read_eol)
-        read_len--;
-    
-    *len = read_len;
-    return true;
+    if (input_lines_head != input_lines_tail)
+        return true;
+
+    if (wake != NULL)
+        wake_func = wake;
+
+    return false;
 
 }
 
@@ -1,5 +1,6 @@
 #include "interrupt.h"
 #include "pit.h"
+#include "vdso.h"
 #include "cpu.h"
 #include "log.h"
 
@@ -37,6 +38,7 @@ static void pit_set_frequency(void) {
 static void pit_interrupt_handler(void) {
     irq_eoi(IRQ_PIT);
     clock++;
+    vdso_set_clock(clock);
     if (active_handler != NULL) {
         active_handler(clock);
     }
@@ -7,6 +7,7 @@
 
 
 static struct process *cons_read_wait_head = NULL;
+static struct process_wait_object cons_read_wait = { LIST_HEAD_INIT(cons_read_wait.watchers) };
 
 
 /// Internal function called by the console driver when enough data
@@ -28,6 +29,11 @@ static void process_wait_cons_read_wake(void) {
 
     cons_read_wait_head = NULL;
 
+    struct process *watch_process = process_wait_object_notify(&cons_read_wait);
+    if (watch_process != NULL && (highest_process == NULL || highest_process->priority < watch_process->priority)) {
+        highest_process = watch_process;
+    }
+
     if (highest_process != NULL && highest_process->priority > process_active->priority) {
         process_sched_advance(highest_process);
     }
@@ -36,17 +42,16 @@ static void process_wait_cons_read_wake(void) {
 
 int process_wait_cons_read(char *dst, size_t len) {
 
-    if (dst != NULL && !process_check_user_ptr(dst))
-        return -1;
-
     if (len == 0)
         return 0;
 
     while (1) {
 
+        // The destination is checked by the console when copying.
         size_t read_len = len;
-        if (cons_try_read(dst, &read_len, process_wait_cons_read_wake))
-            return read_len;
+        int ret = cons_try_read(dst, &read_len, process_wait_cons_read_wake);
+        if (ret != 0)
+            return ret < 0 ? -1 : (int) read_len;
         
         struct process *next_process = process_sched_ring_remove(process_active);
         process_active->state = PROCESS_WAIT_CONS_READ;
@@ -59,6 +64,16 @@ int process_wait_cons_read(char *dst, size_t len) {
 
 }
 
+int process_cons_read_watch(struct process_wait_object **object) {
+
+    if (cons_poll(process_wait_cons_read_wake))
+        return 1;
+
+    *object = &cons_read_wait;
+    return 0;
+
+}
+
 void process_cons_read_kill_process(struct process *process) {
 
     // Remove the process from its wait list.
@@ -0,0 +1,417 @@
+/// Datagram queues, like process queues but messages are byte payloads
+/// of variable size, stored in a byte ring.
+
+#include "internals.h"
+
+#include "process.h"
+#include "memory.h"
+#include "pool.h"
+
+#include "stdio.h"
+#include "string.h"
+
+
+#define DGRAM_POOL_CAP 256
+
+/// Each datagram is stored in the ring after a header giving its size.
+#define DGRAM_HEADER_SIZE sizeof(uint32_t)
+
+static id_pool_t(DGRAM_POOL_CAP) dgram_id_pool = { 0 };
+static struct process_dgram *dgram_pool[DGRAM_POOL_CAP] = { 0 };
+
+
+/// Get a datagram queue pointer from its ID, while checking the
+/// validity of the ID.
+static struct process_dgram *process_dgram_from_did(did_t did) {
+    if (did < 0 || did >= DGRAM_POOL_CAP) {
+        return NULL;
+    } else {
+        return dgram_pool[did];
+    }
+}
+
+/// Add the given process to the waiting list, in priority order. The
+/// process must be in WAIT_DGRAM state.
+static void process_dgram_add_process(struct process_dgram *dgram, struct process *process) {
+    INIT_LINK(&process->wait_dgram.node);
+    queue_add(process, &dgram->wait_list, struct process, wait_dgram.node, priority);
+    dgram->wait_count++;
+}
+
+/// Remove the given process from the waiting list. The process must
+/// be in WAIT_DGRAM state.
+static void process_dgram_remove_process(struct process_dgram *dgram, struct process *process) {
+    queue_del(process, wait_dgram.node);
+    dgram->wait_count--;
+}
+
+/// Pop the waiting process with the highest priority, the oldest one
+/// if several have the same priority.
+static struct process *process_dgram_pop_next(struct process_dgram *dgram) {
+
+    struct process *process = queue_out(&dgram->wait_list, struct process, wait_dgram.node);
+    if (process != NULL)
+        dgram->wait_count--;
+
+    return process;
+
+}
+
+/// Put the active process in wait state for the given datagram queue.
+/// The data is the payload to write or the buffer to read into. The
+/// function returns true if resuming is due to a reset.
+static bool process_dgram_wait(struct process_dgram *dgram, void *data, size_t size) {
+
+    struct process *next_process = process_sched_ring_remove(process_active);
+    process_active->state = PROCESS_WAIT_DGRAM;
+    process_active->wait_dgram.dgram = dgram;
+    process_active->wait_dgram.data = data;
+    process_active->wait_dgram.size = size;
+    process_dgram_add_process(dgram, process_active);
+
+    process_sched_advance(next_process);
+
+    return process_active->sched.wait_dgram_reset;
+
+}
+
+/// Re-schedule a process popped from the waiting list, the size is
+/// returned to it if it was waiting for reading.
+static void process_dgram_wake(struct process *process, size_t size, bool reset) {
+    process->state = PROCESS_SCHED;
+    process->sched.wait_dgram_reset = reset;
+    process->sched.wait_dgram_size = size;
+    process_sched_ring_insert(process);
+}
+
+/// Return the ring index after the given number of bytes.
+static size_t process_dgram_ring_advance(struct process_dgram *dgram, size_t index, size_t size) {
+    index += size;
+    if (index >= dgram->capacity)
+        index -= dgram->capacity;
+    return index;
+}
+
+/// Copy bytes in the ring at the given index, wrapping if needed. A
+/// source in the active process' memory is copied with 'copy_from_user'
+/// and -1 is returned if it's invalid.
+static int process_dgram_ring_write(struct process_dgram *dgram, size_t index, const void *src, size_t size, bool user) {
+    size_t first = dgram->capacity - index;
+    if (first > size)
+        first = size;
+    if (user)
+        return copy_from_user(dgram->buffer + index, src, first)
+            || copy_from_user(dgram->buffer, src + first, size - first) ? -1 : 0;
+    memcpy(dgram->buffer + index, src, first);
+    memcpy(dgram->buffer, src + first, size - first);
+    return 0;
+}
+
+/// Copy bytes out of the ring from the given index, wrapping if
+/// needed, see 'process_dgram_ring_write'.
+static int process_dgram_ring_read(struct process_dgram *dgram, size_t index, void *dst, size_t size, bool user) {
+    size_t first = dgram->capacity - index;
+    if (first > size)
+        first = size;
+    if (user)
+        return copy_to_user(dst, dgram->buffer + index, first)
+            || copy_to_user(dst + first, dgram->buffer, size - first) ? -1 : 0;
+    memcpy(dst, dgram->buffer + index, first);
+    memcpy(dst + first, dgram->buffer, size - first);
+    return 0;
+}
+
+/// Return true if a datagram of the given size fits in the ring.
+static bool process_dgram_fits(struct process_dgram *dgram, size_t size) {
+    return dgram->capacity - dgram->used >= DGRAM_HEADER_SIZE + size;
+}
+
+/// Write a datagram to the ring (without checking if space is
+/// available). The payload is copied before the header, so nothing is
+/// written if a user payload is invalid, -1 is returned in this case.
+static int process_dgram_raw_write(struct process_dgram *dgram, const void *data, size_t size, bool user) {
+
+    size_t index = process_dgram_ring_advance(dgram, dgram->write_index, DGRAM_HEADER_SIZE);
+    if (process_dgram_ring_write(dgram, index, data, size, user))
+        return -1;
+
+    uint32_t header = size;
+    process_dgram_ring_write(dgram, dgram->write_index, &header, DGRAM_HEADER_SIZE, false);
+
+    dgram->write_index = process_dgram_ring_advance(dgram, index, size);
+    dgram->used += DGRAM_HEADER_SIZE + size;
+    dgram->count++;
+
+    return 0;
+
+}
+
+/// Read a datagram from the ring (without checking if one is
+/// available) into the active process' memory. The payload is
+/// truncated to the given buffer size, the full size of the datagram
+/// is returned, or -1 if the buffer is invalid and nothing is read.
+static int process_dgram_raw_read(struct process_dgram *dgram, void *dst, size_t dst_size) {
+
+    uint32_t header;
+    process_dgram_ring_read(dgram, dgram->read_index, &header, DGRAM_HEADER_SIZE, false);
+
+    size_t index = process_dgram_ring_advance(dgram, dgram->read_index, DGRAM_HEADER_SIZE);
+    if (process_dgram_ring_read(dgram, index, dst, header < dst_size ? header : dst_size, true))
+        return -1;
+
+    dgram->read_index = process_dgram_ring_advance(dgram, index, header);
+    dgram->used -= DGRAM_HEADER_SIZE + header;
+    dgram->count--;
+
+    return header;
+
+}
+
+/// Move the payloads of waiting writers into the ring while they fit,
+/// in priority order, and re-schedule them. The highest priority
+/// process woken up is returned, if any.
+static struct process *process_dgram_resume_writers(struct process_dgram *dgram) {
+
+    struct process *wake_process = NULL;
+
+    while (dgram->wait_count != 0) {
+
+        struct process *next_process = queue_top(&dgram->wait_list, struct process, wait_dgram.node);
+        if (!process_dgram_fits(dgram, next_process->wait_dgram.size))
+            break;
+
+        // The payload was checked when the writer started waiting.
+        process_dgram_pop_next(dgram);
+        process_dgram_raw_write(dgram, next_process->wait_dgram.data, next_process->wait_dgram.size, false);
+        process_dgram_wake(next_process, 0, false);
+
+        if (wake_process == NULL)
+            wake_process = next_process;
+
+    }
+
+    return wake_process;
+
+}
+
+/// Resume all waiting processes and set the reset flag to true so
+/// they will return -1 on return.
+static void process_dgram_resume_reset(struct process_dgram *dgram) {
+
+    struct process *wake_process = process_dgram_pop_next(dgram);
+    struct process *wait_process = wake_process;
+
+    while (wait_process != NULL) {
+        process_dgram_wake(wait_process, 0, true);
+        wait_process = process_dgram_pop_next(dgram);
+    }
+
+    if (wake_process != NULL && wake_process->priority > process_active->priority) {
+        process_sched_advance(wake_process);
+    }
+
+}
+
+did_t process_dgram_create(int capacity, int max_size) {
+
+    if (capacity <= 0 || max_size <= 0 || id_pool_empty(dgram_id_pool))
+        return -1;
+
+    // The largest datagram must always fit in an empty ring, this way
+    // waiting processes are readers if the ring is empty and writers
+    // otherwise.
+    if ((size_t) capacity < DGRAM_HEADER_SIZE || (size_t) max_size > (size_t) capacity - DGRAM_HEADER_SIZE)
+        return -1;
+
+    uint8_t *buffer = kalloc(capacity);
+    if (buffer == NULL)
+        return -1;
+
+    struct process_dgram *dgram = kalloc(sizeof(struct process_dgram));
+    if (dgram == NULL) {
+        kfree(buffer);
+        return -1;
+    }
+
+    dgram->buffer = buffer;
+    dgram->capacity = capacity;
+    dgram->max_size = max_size;
+    dgram->used = 0;
+    dgram->count = 0;
+    dgram->read_index = 0;
+    dgram->write_index = 0;
+    INIT_LIST_HEAD(&dgram->wait_list);
+    dgram->wait_count = 0;
+
+    dgram->did = id_pool_alloc(dgram_id_pool);
+    dgram_pool[dgram->did] = dgram;
+
+    return dgram->did;
+
+}
+
+int process_dgram_delete(did_t did) {
+
+    struct process_dgram *dgram = process_dgram_from_did(did);
+    if (dgram == NULL)
+        return -1;
+
+    dgram_pool[dgram->did] = NULL;
+    id_pool_free(dgram_id_pool, dgram->did);
+
+    process_dgram_resume_reset(dgram);
+
+    kfree(dgram->buffer);
+    kfree(dgram);
+
+    return 0;
+
+}
+
+int process_dgram_send(did_t did, const void *data, int size) {
+
+    if (size < 0)
+        return -1;
+
+    struct process_dgram *dgram = process_dgram_from_did(did);
+    if (dgram == NULL || (size_t) size > dgram->max_size)
+        return -1;
+
+    if (dgram->count == 0 && dgram->wait_count != 0) {
+
+        // Processes are waiting for reading, directly copy the payload
+        // to the buffer of the highest priority one, it is only popped
+        // once the copy succeeded.
+        struct process *next_process = queue_top(&dgram->wait_list, struct process, wait_dgram.node);
+        size_t copy_size = next_process->wait_dgram.size;
+        if (copy_size > (size_t) size)
+            copy_size = size;
+
+        if (copy_from_user(next_process->wait_dgram.data, data, copy_size))
+            return -1;
+
+        process_dgram_pop_next(dgram);
+        process_dgram_wake(next_process, size, false);
+
+        if (next_process->priority > process_active->priority) {
+            process_sched_advance(next_process);
+        }
+
+    } else if (dgram->wait_count != 0 || !process_dgram_fits(dgram, size)) {
+
+        // Also wait if other writers are waiting, so that large
+        // datagrams are not starved by smaller ones. The receiving
+        // process will copy our payload while we are blocked, so it
+        // is checked before.
+        if (!process_check_user_range(data, size) || process_dgram_wait(dgram, (void *) data, size))
+            return -1;
+
+    } else {
+        return process_dgram_raw_write(dgram, data, size, true);
+    }
+
+    return 0;
+
+}
+
+int process_dgram_receive(did_t did, void *data, int size) {
+
+    if (size < 0)
+        return -1;
+
+    struct process_dgram *dgram = process_dgram_from_did(did);
+    if (dgram == NULL)
+        return -1;
+
+    if (dgram->count == 0) {
+
+        // The sending process will copy its payload to our buffer
+        // while we are blocked, so it is checked before.
+        if (!process_check_user_range(data, size) || process_dgram_wait(dgram, data, size))
+            return -1;
+
+        return process_active->sched.wait_dgram_size;
+
+    } else {
+
+        int full_size = process_dgram_raw_read(dgram, data, size);
+        if (full_size < 0)
+            return -1;
+
+        struct process *wake_process = process_dgram_resume_writers(dgram);
+        if (wake_process != NULL && wake_process->priority > process_active->priority) {
+            process_sched_advance(wake_process);
+        }
+
+        return full_size;
+
+    }
+
+}
+
+int process_dgram_count(did_t did, int *count, int *used) {
+
+    if (count != NULL && !process_check_user_range(count, sizeof(int)))
+        return -1;
+    if (used != NULL && !process_check_user_range(used, sizeof(int)))
+        return -1;
+
+    struct process_dgram *dgram = process_dgram_from_did(did);
+    if (dgram == NULL)
+        return -1;
+
+    // Same convention as queues: negative number of waiting readers
+    // if empty, or datagrams plus waiting writers.
+    if (count != NULL) {
+        if (dgram->count == 0) {
+            *count = -(int) dgram->wait_count;
+        } else {
+            *count = dgram->count + dgram->wait_count;
+        }
+    }
+
+    if (used != NULL)
+        *used = dgram->used;
+
+    return 0;
+
+}
+
+int process_dgram_reset(did_t did) {
+
+    struct process_dgram *dgram = process_dgram_from_did(did);
+    if (dgram == NULL)
+        return -1;
+
+    dgram->used = 0;
+    dgram->count = 0;
+    dgram->read_index = 0;
+    dgram->write_index = 0;
+
+    process_dgram_resume_reset(dgram);
+
+    return 0;
+
+}
+
+void process_dgram_set_priority(struct process *process, int new_priority) {
+
+    process->priority = new_priority;
+
+    process_dgram_remove_process(process->wait_dgram.dgram, process);
+    process_dgram_add_process(process->wait_dgram.dgram, process);
+
+}
+
+void process_dgram_kill_process(struct process *process) {
+
+    struct process_dgram *dgram = process->wait_dgram.dgram;
+    process_dgram_remove_process(dgram, process);
+
+    // If the killed writer was the first one, the next ones may fit,
+    // they are only re-scheduled because we are in the middle of a
+    // kill.
+    if (dgram->count != 0)
+        process_dgram_resume_writers(dgram);
+
+}
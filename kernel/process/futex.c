@@ -0,0 +1,137 @@
+/// Futex-style wait and wake on user addresses, waiting processes are
+/// kept in buckets hashed by address.
+
+#include "internals.h"
+
+#include "process.h"
+#include "pit.h"
+
+#include "stdio.h"
+
+
+// Must be a power of two.
+#define FUTEX_BUCKET_COUNT 64
+
+/// Each bucket is ordered by priority, and FIFO for equal priorities,
+/// processes waiting for different addresses can share a bucket.
+static link futex_buckets[FUTEX_BUCKET_COUNT];
+static bool futex_buckets_init = false;
+
+
+static link *process_futex_bucket(const int *addr) {
+
+    if (!futex_buckets_init) {
+        for (size_t i = 0; i < FUTEX_BUCKET_COUNT; i++)
+            INIT_LIST_HEAD(&futex_buckets[i]);
+        futex_buckets_init = true;
+    }
+
+    // Fibonacci hashing, keeping the high bits of the product.
+    size_t hash = ((size_t) addr >> 2) * 2654435761u;
+    return &futex_buckets[(hash >> 26) & (FUTEX_BUCKET_COUNT - 1)];
+
+}
+
+/// Check that the address can be used as a futex.
+static bool process_futex_check(const int *addr) {
+    return process_check_user_range(addr, sizeof(int)) && ((size_t) addr & (sizeof(int) - 1)) == 0;
+}
+
+int process_futex_wait(const int *addr, int expected, uint32_t clock) {
+
+    if (!process_futex_check(addr))
+        return -1;
+
+    // The comparison and the wait are atomic because the kernel is
+    // not interruptible.
+    if (*addr != expected)
+        return SYSCALL_WOULD_BLOCK;
+
+    if (clock != 0 && clock <= pit_clock_get())
+        return SYSCALL_WOULD_BLOCK;
+
+    struct process *next_process = process_sched_ring_remove(process_active);
+    process_active->state = PROCESS_WAIT_FUTEX;
+    process_active->wait_futex.addr = addr;
+    INIT_LINK(&process_active->wait_futex.node);
+    queue_add(process_active, process_futex_bucket(addr), struct process, wait_futex.node, priority);
+
+    if (clock != 0) {
+        process_active->timeout.target_clock = clock;
+        process_time_queue_add(process_active);
+    }
+
+    process_sched_advance(next_process);
+
+    return process_active->sched.wait_timeout ? SYSCALL_WOULD_BLOCK : 0;
+
+}
+
+int process_futex_wake(const int *addr, int count) {
+
+    if (count < 0 || !process_futex_check(addr))
+        return -1;
+
+    link *bucket = process_futex_bucket(addr);
+    struct process *wake_process = NULL;
+    int woken = 0;
+
+    // Iterate from the highest priority, the last of the bucket.
+    link *it = bucket->prev;
+    while (it != bucket && woken < count) {
+
+        link *prev = it->prev;
+        struct process *process = queue_entry(it, struct process, wait_futex.node);
+
+        if (process->wait_futex.addr == addr) {
+
+            queue_del(process, wait_futex.node);
+            process_time_queue_remove(process);
+
+            process->state = PROCESS_SCHED;
+            process->sched.wait_timeout = false;
+            process_sched_ring_insert(process);
+
+            if (wake_process == NULL)
+                wake_process = process;
+
+            woken++;
+
+        }
+
+        it = prev;
+
+    }
+
+    if (wake_process != NULL && wake_process->priority > process_active->priority) {
+        process_sched_advance(wake_process);
+    }
+
+    return woken;
+
+}
+
+void process_futex_set_priority(struct process *process, int new_priority) {
+
+    process->priority = new_priority;
+
+    link *bucket = process_futex_bucket(process->wait_futex.addr);
+    queue_del(process, wait_futex.node);
+    queue_add(process, bucket, struct process, wait_futex.node, priority);
+
+}
+
+void process_futex_kill_process(struct process *process) {
+    queue_del(process, wait_futex.node);
+    process_time_queue_remove(process);
+}
+
+void process_futex_timeout_process(struct process *process) {
+
+    queue_del(process, wait_futex.node);
+
+    process->state = PROCESS_SCHED;
+    process->sched.wait_timeout = true;
+    process_sched_ring_insert(process);
+
+}
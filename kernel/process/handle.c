@@ -0,0 +1,88 @@
+#include "handle.h"
+#include "memory.h"
+
+#include "stdio.h"
+
+
+#define HANDLE_INDEX_MASK ((1 << HANDLE_INDEX_BITS) - 1)
+
+
+static struct handle_entry *handle_entry(const struct handle_table *table, size_t index) {
+    return &table->chunks[index >> HANDLE_CHUNK_BITS][index & (HANDLE_CHUNK_CAP - 1)];
+}
+
+/// Allocate a new chunk of entries and add them to the free list.
+static bool handle_table_grow(struct handle_table *table) {
+
+    size_t chunk_index = table->capacity >> HANDLE_CHUNK_BITS;
+    if (chunk_index >= HANDLE_DIR_CAP)
+        return false;
+
+    struct handle_entry *chunk = kalloc(sizeof(struct handle_entry) * HANDLE_CHUNK_CAP);
+    if (chunk == NULL)
+        return false;
+
+    // Entries are chained in increasing order, so that the first
+    // handles of a new chunk are allocated first.
+    for (int i = 0; i < HANDLE_CHUNK_CAP; i++) {
+        chunk[i].object = NULL;
+        chunk[i].generation = 0;
+        chunk[i].next_free = i + 1 < HANDLE_CHUNK_CAP ? (int) table->capacity + i + 1 : table->free;
+    }
+
+    table->chunks[chunk_index] = chunk;
+    table->free = table->capacity;
+    table->capacity += HANDLE_CHUNK_CAP;
+
+    return true;
+
+}
+
+int handle_alloc(struct handle_table *table, void *object) {
+
+    if (handle_table_full(table))
+        return -1;
+
+    if (table->free < 0 && !handle_table_grow(table))
+        return -1;
+
+    int index = table->free;
+    struct handle_entry *entry = handle_entry(table, index);
+    table->free = entry->next_free;
+    table->count++;
+
+    entry->object = object;
+    return (int) (entry->generation << HANDLE_INDEX_BITS) | index;
+
+}
+
+void handle_free(struct handle_table *table, int handle) {
+
+    int index = handle & HANDLE_INDEX_MASK;
+    struct handle_entry *entry = handle_entry(table, index);
+    assert(entry->object != NULL);
+
+    entry->object = NULL;
+    entry->generation = (entry->generation + 1) & HANDLE_GENERATION_MASK;
+    entry->next_free = table->free;
+    table->free = index;
+    table->count--;
+
+}
+
+void *handle_get(const struct handle_table *table, int handle) {
+
+    if (handle < 0)
+        return NULL;
+
+    size_t index = handle & HANDLE_INDEX_MASK;
+    if (index >= table->capacity)
+        return NULL;
+
+    const struct handle_entry *entry = handle_entry(table, index);
+    if (entry->object == NULL || entry->generation != ((uint32_t) handle >> HANDLE_INDEX_BITS))
+        return NULL;
+
+    return entry->object;
+
+}
@@ -3,6 +3,7 @@
 
 #include "stdbool.h"
 #include "stdint.h"
+#include "queue.h"
 
 #include "process.h"
 
@@ -14,14 +15,14 @@
 
 #define KERNEL_STACK_SIZE 512
 
-
-// TODO: May be a good idea to have a more generic wait support, with
-// generic wait but with different peripherals behind. Like time and
-// console read for exemple. But it's a bit too complicated for now.
+/// Maximum number of sources for 'process_wait_any'.
+#define PROCESS_WAIT_ANY_CAP 16
 
 
 struct process;
 struct process_queue;
+struct process_dgram;
+struct process_shm_attach;
 
 /// States that a process can take, used for scheduling.
 enum process_state {
@@ -40,6 +41,21 @@ enum process_state {
     /// The process is dead and is waiting termination by its parent,
     /// if the parent is itself a zombie, the process is just freed.
     PROCESS_ZOMBIE,
+    /// The process is waiting to read/write from/to a datagram queue.
+    PROCESS_WAIT_DGRAM,
+    /// The process is waiting for any of many wait objects to be
+    /// ready, see 'process_wait_any'.
+    PROCESS_WAIT_ANY,
+    /// The process is waiting on a user address, see 'futex.c'.
+    PROCESS_WAIT_FUTEX,
+    /// The process is waiting for a synchronization object, see
+    /// 'sync.c'.
+    PROCESS_WAIT_SYNC,
+    /// The process is waiting in the call list of a queue, either as
+    /// a caller or as a server, see 'process_queue_call'.
+    PROCESS_WAIT_CALL,
+    /// The process has its call received and waits for the reply.
+    PROCESS_WAIT_REPLY,
 };
 
 /// Scheduler-specific state for process that are in 
@@ -58,6 +74,21 @@ struct process_state_sched {
     /// Used when resuming from the `PROCESS_WAIT_QUEUE`, it indicates
     /// if the process was resumed by a reset.
     bool wait_queue_reset;
+    /// Used when resuming from a timed wait (other than 
+    /// `PROCESS_WAIT_TIME`), it indicates if the deadline was reached.
+    bool wait_timeout;
+    /// The process is resumed from `PROCESS_WAIT_DGRAM` because it
+    /// was waiting to receive a datagram, its full size is given here.
+    size_t wait_dgram_size;
+    /// Used when resuming from the `PROCESS_WAIT_DGRAM`, it indicates
+    /// if the process was resumed by a reset.
+    bool wait_dgram_reset;
+    /// Used when resuming from `PROCESS_WAIT_SYNC`, the value returned
+    /// by the wait, -1 if the object was reset or deleted.
+    int wait_sync_status;
+    /// Used when resuming from `PROCESS_WAIT_CALL` as a server, the
+    /// PID of the caller, the message is in `wait_queue_message`.
+    pid_t wait_call_pid;
 };
 
 /// For process that are in `PROCESS_WAIT_CHILD`.
@@ -66,22 +97,59 @@ struct process_state_wait_child {
     pid_t child_pid;
 };
 
-struct process_state_wait_time {
-    /// Next process in the wait time linked list.
+/// Not part of the state union because a process can be in the time
+/// queue while waiting for something else, with a deadline. This is 
+/// valid while the process is in `PROCESS_WAIT_TIME` or in a timed
+/// wait.
+struct process_timeout {
+    /// Next process in the time queue.
     struct process *next;
     /// Target clock time at which the process should be rescheduled.
     uint32_t target_clock;
+    /// True while the process is in the time queue.
+    bool queued;
 };
 
 struct process_state_wait_queue {
-    /// Previous process in the wait queue linked list.
-    struct process *prev;
-    /// Next process in the wait queue linked list.
-    struct process *next;
+    /// Link in the queue's waiting list, ordered by priority.
+    link node;
     /// Pointer to the queue currently used by the process.
     struct process_queue *queue;
     /// The message waiting to be written.
     int message;
+    /// Priority of the message waiting to be written, for queues with
+    /// message priorities.
+    int message_priority;
+};
+
+struct process_state_wait_call {
+    /// Link in the queue's call list, ordered by priority.
+    link node;
+    /// Pointer to the queue currently used by the process.
+    struct process_queue *queue;
+    /// True if the process is a server waiting for a call.
+    bool server;
+    /// The message of the call, for callers.
+    int message;
+};
+
+struct process_state_wait_reply {
+    /// Link in the server's reply list, ordered by priority.
+    link node;
+    /// The server that received the call.
+    struct process *server;
+};
+
+struct process_state_wait_dgram {
+    /// Link in the datagram queue's waiting list, ordered by priority.
+    link node;
+    /// Pointer to the datagram queue currently used by the process.
+    struct process_dgram *dgram;
+    /// The payload waiting to be written, or the buffer to receive 
+    /// into, in the process' user memory.
+    void *data;
+    /// Size of the payload or of the receiving buffer.
+    size_t size;
 };
 
 struct process_state_wait_cons_read {
@@ -89,6 +157,64 @@ struct process_state_wait_cons_read {
     struct process *next;
 };
 
+/// A watch registered by a process in the watchers list of a wait
+/// object, for `PROCESS_WAIT_ANY`.
+struct process_watch {
+    /// Link in the wait object's watchers list.
+    link node;
+    /// Priority of the process when registering.
+    int priority;
+    /// The watching process.
+    struct process *process;
+};
+
+/// Generic wait object, embedded in anything that a process can wait
+/// for with 'process_wait_any'. It must be notified when it might
+/// have become ready.
+struct process_wait_object {
+    /// Head of the watches list, ordered by priority.
+    link watchers;
+};
+
+struct process_state_wait_futex {
+    /// Link in the futex bucket of the address, ordered by priority.
+    link node;
+    /// User address waited on.
+    const int *addr;
+};
+
+struct process_state_wait_sync {
+    /// Link in the object's waiting list, ordered by priority.
+    link node;
+    /// The object waited for.
+    struct process_sync *sync;
+    /// For condition variables, the mutex to lock again when signaled.
+    mutexid_t mutex_id;
+};
+
+struct process_state_wait_any {
+    /// Watches registered in wait objects, some might be unused for
+    /// clock sources.
+    struct process_watch watches[PROCESS_WAIT_ANY_CAP];
+    /// Number of watches used.
+    size_t count;
+};
+
+/// Syscall ring registered by a process, the layout is copied on
+/// setup so that the kernel only reads indices and entries from user
+/// memory.
+struct process_ring {
+    /// The user structure, null if no ring is registered.
+    struct syscall_ring *ring;
+    struct syscall_ring_sqe *sq;
+    struct syscall_ring_cqe *cq;
+    /// Number of entries minus one.
+    uint32_t mask;
+    /// True if the next entry must be canceled because it is linked
+    /// to a failed one.
+    bool cancel;
+};
+
 /// Zombie-specific state for process that are in `PROCESS_ZOMBIE`.
 struct process_state_zombie {
     /// Exit code of the process.
@@ -124,15 +250,46 @@ struct process {
         struct process_state_sched sched;
         /// Valid for `PROCESS_WAIT_CHILD`.
         struct process_state_wait_child wait_child;
-        /// Valid for `PROCESS_WAIT_TIME`.
-        struct process_state_wait_time wait_time;
         /// Valid for `PROCESS_WAIT_QUEUE`.
         struct process_state_wait_queue wait_queue;
         /// Valid for `PROCESS_WAIT_CONS_READ`.
         struct process_state_wait_cons_read wait_cons_read;
         /// Valid for `PROCESS_ZOMBIE`.
         struct process_state_zombie zombie;
+        /// Valid for `PROCESS_WAIT_DGRAM`.
+        struct process_state_wait_dgram wait_dgram;
+        /// Valid for `PROCESS_WAIT_ANY`.
+        struct process_state_wait_any wait_any;
+        /// Valid for `PROCESS_WAIT_FUTEX`.
+        struct process_state_wait_futex wait_futex;
+        /// Valid for `PROCESS_WAIT_SYNC`.
+        struct process_state_wait_sync wait_sync;
+        /// Valid for `PROCESS_WAIT_CALL`.
+        struct process_state_wait_call wait_call;
+        /// Valid for `PROCESS_WAIT_REPLY`.
+        struct process_state_wait_reply wait_reply;
     };
+    /// Deadline and link in the time queue, see 'process_timeout'.
+    struct process_timeout timeout;
+    /// Notified when a child becomes a zombie.
+    struct process_wait_object child_wait;
+    /// Linked list of shared memory objects attached by the process.
+    struct process_shm_attach *shm_attach;
+    /// Total size of shared memory objects attached by the process.
+    size_t shm_size;
+    /// Head of callers whose call has been received by this process
+    /// and that wait for its reply.
+    link reply_list;
+    /// True if the syscalls of the process are recorded in the trace
+    /// ring.
+    bool syscall_trace;
+    /// True if the current syscall has been recorded on entry, it is
+    /// completed and pushed to the trace ring on exit.
+    bool syscall_trace_pending;
+    /// The current syscall, if pending.
+    struct syscall_trace_entry syscall_trace_entry;
+    /// Registered syscall ring.
+    struct process_ring ring;
     /// Kernel stack, it is really important and we use it to execute
     /// our interrupt handler so we can resume the execution of the
     /// kernel code when the process is resumed. 
@@ -171,11 +328,155 @@ struct process_queue {
     size_t read_index;
     /// Write index of the queue.
     size_t write_index;
-    /// Head of the waiting processes. When length is equal to 
+    /// Number of message priority levels, zero for a FIFO queue. For
+    /// other queues, the indices above are unused and messages are
+    /// kept in a linked list per level, in the same allocation.
+    size_t levels;
+    /// For each message slot, the next slot in its level or in the
+    /// free list, -1 for the last one.
+    int *links;
+    /// First slot of each level, -1 if the level is empty.
+    int *heads;
+    /// Last slot of each level, -1 if the level is empty.
+    int *tails;
+    /// Bit set for each non-empty level.
+    uint32_t level_mask;
+    /// First free message slot, -1 if the queue is full.
+    int free_index;
+    /// Head of the waiting processes, sorted by priority and FIFO for
+    /// equal priorities (see 'queue.h'). When length is equal to 
     /// capacity then theses processes are waiting for writing, if
     /// length is equal to zero then the processes are waiting for
     /// reading.
-    struct process *wait_process;
+    link wait_list;
+    /// Number of processes in the waiting list.
+    size_t wait_count;
+    /// Notified when messages become available.
+    struct process_wait_object receive_wait;
+    /// Notified when space becomes available.
+    struct process_wait_object send_wait;
+    /// Head of the processes waiting for calls, sorted by priority and
+    /// FIFO for equal priorities. These are either all callers waiting
+    /// for a server, or all servers waiting for a caller.
+    link call_list;
+};
+
+/// A subscriber of a broadcast topic.
+struct process_topic_sub {
+    /// The private queue of the subscriber.
+    qid_t qid;
+    /// Sequence number of the last publication delivered.
+    uint32_t seq;
+    /// Number of messages dropped for this subscriber.
+    uint32_t drops;
+};
+
+struct process_topic {
+    /// Topic ID.
+    tid_t tid;
+    /// Capacity of the subscribers' queues.
+    int capacity;
+    /// Overflow policy, see 'enum topic_overflow'.
+    enum topic_overflow policy;
+    /// Sequence number of the last publication.
+    uint32_t seq;
+    /// Array of subscribers.
+    struct process_topic_sub *subs;
+    /// Number of subscribers.
+    size_t sub_count;
+    /// Capacity of the subscribers array.
+    size_t sub_capacity;
+    /// Number of messages dropped for past and present subscribers.
+    uint32_t drops;
+};
+
+struct process_dgram {
+    /// Datagram queue ID.
+    did_t did;
+    /// Byte ring, each datagram is stored as a 32-bit size followed by
+    /// its payload, both may wrap around the end of the ring.
+    uint8_t *buffer;
+    /// Capacity of the ring in bytes.
+    size_t capacity;
+    /// Maximum payload size of a single datagram.
+    size_t max_size;
+    /// Bytes used in the ring, including sizes.
+    size_t used;
+    /// Number of datagrams in the ring.
+    size_t count;
+    /// Read index of the ring.
+    size_t read_index;
+    /// Write index of the ring.
+    size_t write_index;
+    /// Head of the waiting processes, sorted by priority and FIFO for
+    /// equal priorities. If count is zero then theses processes are 
+    /// waiting for reading, else they are waiting for writing.
+    link wait_list;
+    /// Number of processes in the waiting list.
+    size_t wait_count;
+};
+
+enum process_sync_kind {
+    PROCESS_SYNC_SEM,
+    PROCESS_SYNC_MUTEX,
+    PROCESS_SYNC_COND,
+    PROCESS_SYNC_BARRIER,
+};
+
+/// A synchronization object, each kind has its own ID pool.
+struct process_sync {
+    /// ID in the pool of its kind.
+    int id;
+    /// Kind of object.
+    enum process_sync_kind kind;
+    /// Head of the waiting processes, sorted by priority and FIFO for
+    /// equal priorities.
+    link wait_list;
+    /// Number of processes in the waiting list.
+    size_t wait_count;
+    /// Kind-specific data.
+    union {
+        struct {
+            /// Available count, never positive if processes wait.
+            int count;
+        } sem;
+        struct {
+            /// Owning process, null if unlocked.
+            struct process *owner;
+        } mutex;
+        struct {
+            /// Number of processes to wait for.
+            int count;
+            /// Number of processes arrived in the current round.
+            int arrived;
+        } barrier;
+    };
+};
+
+struct process_shm {
+    /// Shared memory object ID, not valid anymore once destroyed.
+    shmid_t id;
+    /// Pages allocated for the object.
+    void *pages;
+    /// Size of the object in bytes.
+    size_t size;
+    /// User address where the pages are mapped, null if the object is
+    /// not attached by any process.
+    void *addr;
+    /// Total attachments of all processes.
+    size_t attach_count;
+    /// The object has been destroyed and will be freed on last detach.
+    bool destroyed;
+};
+
+/// Attachment of a shared memory object by a process.
+struct process_shm_attach {
+    /// Next attachment of the process.
+    struct process_shm_attach *next;
+    /// The attached object.
+    struct process_shm *shm;
+    /// Number of times the process attached the object.
+    size_t count;
 };
 
 
@@ -251,11 +552,13 @@ void process_sched_set_priority(struct process *process, int new_priority);
 /// Internal function that handle pit interrupts for scheduler.
 void process_sched_pit_handler(uint32_t clock);
 
-/// Add the process to the clock queue, the process must be in the
-/// `PROCESS_WAIT_TIME` state with corresponding data.
+/// Add the process to the clock queue, the process' target clock 
+/// must be set. It must be either in `PROCESS_WAIT_TIME` state or in
+/// a wait state supporting timeouts (`PROCESS_WAIT_QUEUE`, 
+/// `PROCESS_WAIT_ANY` or `PROCESS_WAIT_FUTEX`).
 void process_time_queue_add(struct process *process);
-/// Remove the process from the clock queue. The process must be in 
-/// the `PROCESS_WAIT_TIME` state with corresponding data.
+/// Remove the process from the clock queue, nothing is done if the 
+/// process is not in the clock queue.
 void process_time_queue_remove(struct process *process);
 /// Internal function that handle pit interrupts for clock. It will
 /// automatically reschedule processes that reach their target clock.
@@ -267,11 +570,103 @@ void process_queue_set_priority(struct process *process, int new_priority);
 /// Kill a process that is waiting for queue. The process must be in
 /// `PROCESS_WAIT_QUEUE` state.
 void process_queue_kill_process(struct process *process);
+/// Resume a process whose deadline has been reached while waiting for
+/// a queue. The process must be in `PROCESS_WAIT_QUEUE` state, and it 
+/// has already been removed from the time queue.
+void process_queue_timeout_process(struct process *process);
+/// Change the priority of a process that is waiting in `PROCESS_WAIT_CALL`
+/// or `PROCESS_WAIT_REPLY` state.
+void process_queue_call_set_priority(struct process *process, int new_priority);
+/// Kill a process that is waiting in `PROCESS_WAIT_CALL` or
+/// `PROCESS_WAIT_REPLY` state.
+void process_queue_call_kill_process(struct process *process);
+/// Resume callers waiting for the reply of a process being killed,
+/// their call returns -1.
+void process_queue_call_kill_server(struct process *process);
+
+/// Change the priority of a process that is currently waiting for a
+/// datagram queue. The process must be in `PROCESS_WAIT_DGRAM` state.
+void process_dgram_set_priority(struct process *process, int new_priority);
+/// Kill a process that is waiting for a datagram queue. The process
+/// must be in `PROCESS_WAIT_DGRAM` state.
+void process_dgram_kill_process(struct process *process);
+
+/// Initialize an empty wait object.
+void process_wait_object_init(struct process_wait_object *object);
+/// Wake up all processes watching the wait object, without advancing
+/// scheduling, the highest priority process woken up is returned.
+struct process *process_wait_object_notify(struct process_wait_object *object);
+/// Same as 'process_wait_object_notify' but the highest priority 
+/// process woken up is scheduled if it has priority over the active 
+/// process.
+void process_wait_object_signal(struct process_wait_object *object);
+/// Kill a process that is waiting for any source. The process must be
+/// in `PROCESS_WAIT_ANY` state.
+void process_wait_any_kill_process(struct process *process);
+/// Resume a process whose deadline has been reached while waiting for
+/// any source. It has already been removed from the time queue.
+void process_wait_any_timeout_process(struct process *process);
+
+/// Get a queue pointer from its queue ID, null if the ID is invalid.
+struct process_queue *process_queue_from_qid(qid_t qid);
+/// Deliver a message to a queue without blocking nor preempting, the
+/// highest priority process woken up is kept in the given pointer.
+/// If the queue is full, the oldest message is dropped if requested.
+/// Returns 0 if delivered, 1 if delivered by dropping the oldest
+/// message and -1 if the queue is full.
+int process_queue_offer(struct process_queue *queue, int message, bool drop_oldest, struct process **wake_process);
+/// Send a message with the given priority to a queue of given ID
+/// without blocking, 'SYSCALL_WOULD_BLOCK' is returned if it's full.
+int process_queue_try_send(qid_t qid, int message, int priority);
+
+/// Check if a queue is ready for receiving (or sending), returning 1
+/// if ready, -1 if the queue is invalid, or 0 and the object to watch.
+int process_queue_watch(qid_t qid, bool send, struct process_wait_object **object);
+/// Check if a child (any if negative PID) of the active process is a
+/// zombie, same return values as 'process_queue_watch'.
+int process_child_watch(pid_t pid, struct process_wait_object **object);
+/// Check if a line can be read from the console, same return values
+/// as 'process_queue_watch'.
+int process_cons_read_watch(struct process_wait_object **object);
+
+/// Change the priority of a process that is currently waiting on a
+/// futex. The process must be in `PROCESS_WAIT_FUTEX` state.
+void process_futex_set_priority(struct process *process, int new_priority);
+/// Kill a process that is waiting on a futex. The process must be in
+/// `PROCESS_WAIT_FUTEX` state.
+void process_futex_kill_process(struct process *process);
+/// Resume a process whose deadline has been reached while waiting on
+/// a futex. It has already been removed from the time queue.
+void process_futex_timeout_process(struct process *process);
+
+/// Change the priority of a process that is currently waiting for a
+/// synchronization object. The process must be in `PROCESS_WAIT_SYNC`.
+void process_sync_set_priority(struct process *process, int new_priority);
+/// Kill a process that is waiting for a synchronization object. The
+/// process must be in `PROCESS_WAIT_SYNC` state.
+void process_sync_kill_process(struct process *process);
+/// Release all mutexes owned by a process being killed.
+void process_mutex_kill_owner(struct process *process);
+
+/// Detach all shared memory objects of a process being killed.
+void process_shm_kill_process(struct process *process);
 
 /// Kill a process that is waiting for a console read. The process 
 /// must be in `PROCESS_WAIT_CONS_READ` state.
 void process_cons_read_kill_process(struct process *process);
 
+/// Stop tracing the syscalls of a process being killed.
+void syscall_trace_kill_process(struct process *process);
+
+/// Type alias for a syscall function handler.
+typedef void *syscall_handler_t;
+
+/// Syscall handlers and counters, defined in 'syscall.c' for the
+/// assembly dispatch, also used by syscall rings.
+extern syscall_handler_t syscall_handlers[SYSCALL_COUNT];
+extern uint32_t syscall_stats_count[SYSCALL_COUNT];
+extern uint64_t syscall_stats_cycles[SYSCALL_COUNT];
+
 /// Internal function to debug print a process.
 void process_debug(struct process *process);
 
@@ -4,16 +4,17 @@
 #include "process.h"
 #include "segment.h"
 #include "memory.h"
-#include "pool.h"
+#include "handle.h"
 
 #include "string.h"
 #include "stdio.h"
 
 
-#define PROCESS_POOL_CAP 1024
+/// Maximum number of live processes, the table itself grows on demand
+/// so this limit can be raised freely up to the handle index space.
+#define PROCESS_MAX 1024
 
-static id_pool_t(PROCESS_POOL_CAP) process_id_pool = { 0 };
-static struct process *process_pool[PROCESS_POOL_CAP] = { 0 };
+static struct handle_table process_table = HANDLE_TABLE_INIT(PROCESS_MAX);
 
 
 /// Internal function that allocate a process given. Callers of this
@@ -23,7 +24,7 @@ static struct process *process_pool[PROCESS_POOL_CAP] = { 0 };
 /// Interrupts must be disabled before calling this function.
 struct process *process_alloc(process_entry_t entry, size_t stack_size, int priority, const char *name, void *arg) {
 
-    if (id_pool_empty(process_id_pool))
+    if (handle_table_full(&process_table))
         return NULL;
 
     // FIXME: This value need to be adjusted for function called at 
@@ -88,17 +89,32 @@ struct process *process_alloc(process_entry_t entry, size_t stack_size, int prio
 
     process->kernel_esp = (uint32_t) kernel_stack_ptr;
 
+    // Allocate the PID, this can fail if the table needs to grow.
+    process->pid = handle_alloc(&process_table, process);
+    if (process->pid < 0) {
+        kfree(process);
+        kfree(kernel_stack);
+        user_stack_free(stack, stack_size);
+        return NULL;
+    }
+
     // Initialize other fields.
     strncpy(process->name, name, PROCESS_NAME_CAP);
 
+    // Not in the time queue.
+    process->timeout.queued = false;
+    process_wait_object_init(&process->child_wait);
+    process->shm_attach = NULL;
+    process->shm_size = 0;
+    INIT_LIST_HEAD(&process->reply_list);
+    process->syscall_trace = false;
+    process->syscall_trace_pending = false;
+    process->ring.ring = NULL;
+
     // Priority and scheduler ring.
     process->priority = priority;
     process->state = PROCESS_SCHED;
     process_sched_ring_insert(process);
-    
-    // Allocate the PID.
-    process->pid = id_pool_alloc(process_id_pool);
-    process_pool[process->pid] = process;
 
     return process;
 
@@ -141,9 +157,8 @@ void process_free(struct process *process) {
         child = child->sibling;
     }
 
-    // Free the PID.
-    process_pool[process->pid] = NULL;
-    id_pool_free(process_id_pool, process->pid);
+    // Free the PID, it becomes stale.
+    handle_free(&process_table, process->pid);
 
     // Free resources.
     kfree(process);
@@ -153,9 +168,5 @@ void process_free(struct process *process) {
 }
 
 struct process *process_from_pid(pid_t pid) {
-    if (pid < 0 || pid >= PROCESS_POOL_CAP) {
-        return NULL;
-    } else {
-        return process_pool[pid];
-    }
+    return handle_get(&process_table, pid);
 }
@@ -11,6 +11,7 @@
 #include "cpu.h"
 #include "pit.h"
 #include "syscall.h"
+#include "vdso.h"
 
 #include "../debug/user_stack_mem.h"
 
@@ -50,6 +51,12 @@ static void process_internal_kill(struct process *process, int code, bool wake_p
                 }
 
             }
+        } else if (parent->state == PROCESS_WAIT_ANY) {
+            // The parent checks its children again when resuming.
+            struct process *watch_process = process_wait_object_notify(&parent->child_wait);
+            if (watch_process != NULL && watch_process->priority > process->priority) {
+                next_process = watch_process;
+            }
         }
     }
 
@@ -74,6 +81,18 @@ static void process_internal_kill(struct process *process, int code, bool wake_p
     } else if (process->state == PROCESS_WAIT_QUEUE) {
         // If the process is waiting queue, remove it from its queue.
         process_queue_kill_process(process);
+    } else if (process->state == PROCESS_WAIT_DGRAM) {
+        // Same for datagram queues.
+        process_dgram_kill_process(process);
+    } else if (process->state == PROCESS_WAIT_ANY) {
+        // Remove all watches and the deadline.
+        process_wait_any_kill_process(process);
+    } else if (process->state == PROCESS_WAIT_FUTEX) {
+        process_futex_kill_process(process);
+    } else if (process->state == PROCESS_WAIT_SYNC) {
+        process_sync_kill_process(process);
+    } else if (process->state == PROCESS_WAIT_CALL || process->state == PROCESS_WAIT_REPLY) {
+        process_queue_call_kill_process(process);
     } else if (process->state == PROCESS_WAIT_CONS_READ) {
         // If the process is waiting for a console read, remove it.
         process_cons_read_kill_process(process);
@@ -84,6 +103,14 @@ static void process_internal_kill(struct process *process, int code, bool wake_p
         panic("process_internal_kill(...): unsupported state when killing: %d\n", process->state);
     }
 
+    // Shared memory objects are detached as if the process did it,
+    // owned mutexes are released, pending calls fail and tracing
+    // stops.
+    process_shm_kill_process(process);
+    process_mutex_kill_owner(process);
+    process_queue_call_kill_server(process);
+    syscall_trace_kill_process(process);
+
     // Here we want to free all child processes because they will never 
     // be awaited, so we can free all child processes.
     struct process *child_process = process->child;
@@ -129,6 +156,7 @@ void process_idle(process_entry_t entry, size_t stack_size, void *arg) {
     pit_set_handler(process_pit_handler);
 
     // Manually switch to the idle process context.
+    vdso_set_pid(process_active->pid);
     process_context_switch(NULL, process_active);
 
 }
@@ -142,10 +170,13 @@ pid_t process_start(process_entry_t entry, size_t stack_size, int priority, cons
     if (priority < 0 || priority >= PROCESS_MAX_PRIORITY)
         return -1;
 
-    if (!process_check_user_ptr(name))
+    // Static because kernel stacks are too small for it, the kernel is
+    // not preempted before the name is copied by 'process_alloc'.
+    static char name_buffer[PROCESS_NAME_CAP];
+    if (strncpy_from_user(name_buffer, name, PROCESS_NAME_CAP) < 0)
         return -1;
     
-    struct process *process = process_alloc(entry, stack_size, priority, name, arg);
+    struct process *process = process_alloc(entry, stack_size, priority, name_buffer, arg);
     if (process == NULL)
         return -1; // Allocation error.
     
@@ -229,6 +260,14 @@ int process_set_priority(pid_t pid, int priority) {
         // The process is waiting for a queue message, changing 
         // priority is a bit special here.
         process_queue_set_priority(process, priority);
+    } else if (process->state == PROCESS_WAIT_DGRAM) {
+        process_dgram_set_priority(process, priority);
+    } else if (process->state == PROCESS_WAIT_FUTEX) {
+        process_futex_set_priority(process, priority);
+    } else if (process->state == PROCESS_WAIT_SYNC) {
+        process_sync_set_priority(process, priority);
+    } else if (process->state == PROCESS_WAIT_CALL || process->state == PROCESS_WAIT_REPLY) {
+        process_queue_call_set_priority(process, priority);
     } else {
         // Other wait states doesn't require special priority handling.
         process->priority = priority;
@@ -244,7 +283,7 @@ pid_t process_wait(pid_t pid, int *exit_code) {
     if (child == NULL)
         return -1;
     
-    if (exit_code != NULL && !process_check_user_ptr(exit_code))
+    if (exit_code != NULL && !process_check_user_range(exit_code, sizeof(int)))
         return -1;
     
 #if PROCESS_DEBUG
@@ -302,6 +341,28 @@ pid_t process_wait(pid_t pid, int *exit_code) {
 
 }
 
+int process_child_watch(pid_t pid, struct process_wait_object **object) {
+
+    struct process *child = process_active->child;
+    bool found = false;
+
+    while (child != NULL) {
+        if (pid < 0 || pid == child->pid) {
+            if (child->state == PROCESS_ZOMBIE)
+                return 1;
+            found = true;
+        }
+        child = child->sibling;
+    }
+
+    if (!found)
+        return -1;
+
+    *object = &process_active->child_wait;
+    return 0;
+
+}
+
 int process_kill(pid_t pid) {
     
     // Can't kill idle.
@@ -335,7 +396,8 @@ int process_name(pid_t pid, char *dst, int count) {
         return -1;
     
     int name_len = strlen(process->name) + 1; // count 0
-    strncpy(dst, process->name, count <= name_len ? count : name_len);
+    if (dst != NULL && copy_to_user(dst, process->name, count <= name_len ? count : name_len) < 0)
+        return -1;
     
     return name_len;
 
@@ -346,7 +408,8 @@ int process_children(pid_t pid, pid_t *children_pids, int count) {
     if (children_pids != NULL && count < 0)
         return -1;
 
-    if (children_pids != NULL && !process_check_user_ptr(children_pids))
+    // Checked at once, so nothing is written if a part is invalid.
+    if (children_pids != NULL && !process_check_user_array(children_pids, count, sizeof(pid_t)))
         return -1;
 
     struct process *process = process_from_pid(pid);
@@ -398,7 +461,7 @@ void process_wait_clock(uint32_t clock) {
         struct process *next_process = process_sched_ring_remove(process_active);
 
         process_active->state = PROCESS_WAIT_TIME;
-        process_active->wait_time.target_clock = clock;
+        process_active->timeout.target_clock = clock;
 
         // Add the process to the time queue and advanced scheduling while
         // removing it from the ring.
@@ -436,5 +499,79 @@ extern char user_start;
 extern char user_end;
 
 bool process_check_user_ptr(const void *ptr) {
-    return (void *) &user_start <= ptr && ptr < (void *) &user_end;
+    return ((void *) &user_start <= ptr && ptr < (void *) &user_end) || page_user_mapped(ptr);
+}
+
+bool process_check_user_range(const void *ptr, size_t size) {
+
+    if (size == 0)
+        return true;
+
+    const char *start = ptr;
+    const char *end = start + size;
+    if (end < start)
+        return false;
+
+    if (start >= &user_start && end <= &user_end)
+        return true;
+
+    // User space bounds are page aligned, so checking one byte per
+    // page is enough.
+    for (const char *page = start; page < end; page = (const char *) (((size_t) page & ~(PAGE_SIZE - 1)) + PAGE_SIZE)) {
+        if (!process_check_user_ptr(page))
+            return false;
+    }
+
+    return true;
+
+}
+
+bool process_check_user_array(const void *ptr, size_t count, size_t elem_size) {
+    if (elem_size != 0 && count > (size_t) -1 / elem_size)
+        return false;
+    return process_check_user_range(ptr, count * elem_size);
+}
+
+int copy_from_user(void *dst, const void *src, size_t size) {
+    if (!process_check_user_range(src, size))
+        return -1;
+    memcpy(dst, src, size);
+    return 0;
+}
+
+int copy_to_user(void *dst, const void *src, size_t size) {
+    if (!process_check_user_range(dst, size))
+        return -1;
+    memcpy(dst, src, size);
+    return 0;
+}
+
+int strncpy_from_user(char *dst, const char *src, size_t size) {
+
+    if (size == 0)
+        return -1;
+
+    // Each page span is checked once and copied up to the terminator.
+    size_t len = 0;
+    while (len < size - 1) {
+
+        const char *span = src + len;
+        if (!process_check_user_ptr(span))
+            return -1;
+
+        size_t span_len = PAGE_SIZE - ((size_t) span & (PAGE_SIZE - 1));
+        if (span_len > size - 1 - len)
+            span_len = size - 1 - len;
+
+        char *end = memccpy(dst + len, span, 0, span_len);
+        if (end != NULL)
+            return end - dst - 1;
+
+        len += span_len;
+
+    }
+
+    dst[size - 1] = 0;
+    return size - 1;
+
 }
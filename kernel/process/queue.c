@@ -2,127 +2,138 @@
 
 #include "process.h"
 #include "memory.h"
-#include "pool.h"
+#include "handle.h"
+#include "pit.h"
+#include "syscall_shared.h"
 
 #include "stdio.h"
+#include "string.h"
 
 
-#define QUEUE_POOL_CAP 256
+/// Maximum number of live queues, see 'PROCESS_MAX'.
+#define QUEUE_MAX 1024
+/// Maximum number of message priority levels, see 'level_mask'.
+#define QUEUE_LEVELS_MAX 32
 
-static id_pool_t(QUEUE_POOL_CAP) queue_id_pool = { 0 };
-static struct process_queue *queue_pool[QUEUE_POOL_CAP] = { 0 };
+static struct handle_table queue_table = HANDLE_TABLE_INIT(QUEUE_MAX);
 
 
-/// Get a queue pointer from its queue ID, while checking the validity
-/// of the QID.
-static struct process_queue *process_queue_from_qid(qid_t qid) {
-    if (qid < 0 || qid >= QUEUE_POOL_CAP) {
-        return NULL;
-    } else {
-        return queue_pool[qid];
-    }
+struct process_queue *process_queue_from_qid(qid_t qid) {
+    return handle_get(&queue_table, qid);
 }
 
-/// Add the given process to the queue's waiting list. The process
-/// must be in WAIT_QUEUE state.
+/// Add the given process to the queue's waiting list, in priority
+/// order. The process must be in WAIT_QUEUE state.
 static void process_queue_add_process(struct process_queue *queue, struct process *process) {
-    process->wait_queue.prev = NULL;
-    process->wait_queue.next = queue->wait_process;
-    if (queue->wait_process != NULL)
-        queue->wait_process->wait_queue.prev = process;
-    queue->wait_process = process;
+    INIT_LINK(&process->wait_queue.node);
+    queue_add(process, &queue->wait_list, struct process, wait_queue.node, priority);
+    queue->wait_count++;
 }
 
 /// Remove the given process from the queue's waiting list. The 
 /// process must be in WAIT_QUEUE state.
 static void process_queue_remove_process(struct process_queue *queue, struct process *process) {
-    // If it's the head of the queue.
-    if (process->wait_queue.prev == NULL) {
-        queue->wait_process = process->wait_queue.next;
-        if (queue->wait_process != NULL)
-            queue->wait_process->wait_queue.prev = NULL;
-    } else {
-        struct process *prev_process = process->wait_queue.prev;
-        struct process *next_process = process->wait_queue.next;
-        prev_process->wait_queue.next = next_process;
-        if (next_process != NULL)
-            next_process->wait_queue.prev = prev_process;
-    }
+    queue_del(process, wait_queue.node);
+    queue->wait_count--;
 }
 
 /// Put the active process in wait state for the given queue. 
-/// The message can be given if relevant (writing wait).
-/// The function returns true if resuming is due to a reset.
-static bool process_queue_wait(struct process_queue *queue, int message) {
+/// The message can be given if relevant (writing wait). If a deadline
+/// is given, the process is also put in the time queue, and the wait
+/// is not even started if the deadline is already reached.
+/// 
+/// The function returns 0 if the wait completed, -1 if resuming is 
+/// due to a reset and 'SYSCALL_WOULD_BLOCK' if the deadline has been
+/// reached.
+static int process_queue_wait(struct process_queue *queue, int message, int message_priority, const uint32_t *deadline) {
+
+    if (deadline != NULL && *deadline <= pit_clock_get())
+        return SYSCALL_WOULD_BLOCK;
 
     // Queue is full, just block this process until the message
     // has been added.
     struct process *next_process = process_sched_ring_remove(process_active);
     process_active->state = PROCESS_WAIT_QUEUE;
     process_active->wait_queue.message = message;
+    process_active->wait_queue.message_priority = message_priority;
     process_active->wait_queue.queue = queue;
     process_queue_add_process(queue, process_active);
 
+    // The first of the queue or the time queue to resume the process
+    // removes it from the other one.
+    if (deadline != NULL) {
+        process_active->timeout.target_clock = *deadline;
+        process_time_queue_add(process_active);
+    }
+
     // Schedule a new process.
     process_sched_advance(next_process);
 
     // When resuming, we know that the receiving process has
     // written our message.
-    return process_active->sched.wait_queue_reset;
+    if (process_active->sched.wait_queue_reset)
+        return -1;
+    if (process_active->sched.wait_timeout)
+        return SYSCALL_WOULD_BLOCK;
+
+    return 0;
 
 }
 
-/// This function find the next process that should have higher 
-/// priority in the given list. Returning null if no process in
-/// the queue.
+/// This function pops the waiting process with the highest priority,
+/// the oldest one if several have the same priority. Returning null
+/// if no process in the queue. The process is also removed from the
+/// time queue if it was a timed wait.
 static struct process *process_queue_pop_next(struct process_queue *queue) {
 
-    struct process *wait_process = queue->wait_process;
-    struct process *candidate_process = NULL;
-
-    while (wait_process != NULL) {
-
-        // If all processes in the list have the same priority, then
-        // the last one will be the awaken one.
-        if (candidate_process == NULL || candidate_process->priority <= wait_process->priority)
-            candidate_process = wait_process;
-
-        wait_process = wait_process->wait_queue.next;
-
+    struct process *process = queue_out(&queue->wait_list, struct process, wait_queue.node);
+    if (process != NULL) {
+        queue->wait_count--;
+        process_time_queue_remove(process);
     }
 
-    if (candidate_process != NULL) {
-        process_queue_remove_process(queue, candidate_process);
-    }
-
-    return candidate_process;
+    return process;
 
 }
 
 /// Resume all waiting processes and set the reset flag to true so
-/// they will return -1 on return. The given process must be in WAIT_QUEUE
-static void process_queue_resume_reset(struct process **wait_process_ptr) {
+/// they will return -1 on return. Processes watching the queue are
+/// also woken up, so they see it empty or deleted.
+static void process_queue_resume_reset(struct process_queue *queue) {
 
-    struct process *wait_process = *wait_process_ptr;
-    struct process *wake_process = NULL;
+    // The first process popped has the highest priority.
+    struct process *wake_process = process_queue_pop_next(queue);
+    struct process *wait_process = wake_process;
 
     while (wait_process != NULL) {
-
-        if (wake_process == NULL || wake_process->priority < wait_process->priority)
-            wake_process = wait_process;
-        
-        // Save the next process here because state is changed.
-        struct process *next_process = wait_process->wait_queue.next;
-
         wait_process->state = PROCESS_SCHED;
         wait_process->sched.wait_queue_reset = true;
+        wait_process->sched.wait_timeout = false;
         process_sched_ring_insert(wait_process);
+        wait_process = process_queue_pop_next(queue);
+    }
+
+    // Same for callers or servers waiting for calls.
+    struct process *call_process;
+    while ((call_process = queue_out(&queue->call_list, struct process, wait_call.node)) != NULL) {
+        call_process->state = PROCESS_SCHED;
+        call_process->sched.wait_queue_reset = true;
+        process_sched_ring_insert(call_process);
+        if (wake_process == NULL || call_process->priority > wake_process->priority)
+            wake_process = call_process;
+    }
 
-        wait_process = next_process;
+    struct process *watch_processes[2] = {
+        process_wait_object_notify(&queue->receive_wait),
+        process_wait_object_notify(&queue->send_wait)
+    };
 
+    for (size_t i = 0; i < 2; i++) {
+        struct process *watch_process = watch_processes[i];
+        if (watch_process != NULL && (wake_process == NULL || watch_process->priority > wake_process->priority)) {
+            wake_process = watch_process;
+        }
     }
-    
-    *wait_process_ptr = NULL;
 
     // The highest priority process has greater priority than running
     // process? Schedule it.
@@ -132,39 +143,202 @@ static void process_queue_resume_reset(struct process **wait_process_ptr) {
 
 }
 
-/// Send a message to a queue (without checking if space is available).
-/// It returns the previous length.
-static size_t process_queue_raw_write(struct process_queue *queue, int message) {
-    queue->messages[queue->write_index] = message;
-    if (++queue->write_index == queue->capacity)
-        queue->write_index = 0;
+/// Empty the message storage of a queue.
+static void process_queue_clear(struct process_queue *queue) {
+
+    queue->length = 0;
+    queue->read_index = 0;
+    queue->write_index = 0;
+
+    if (queue->levels != 0) {
+        for (size_t i = 0; i < queue->capacity; i++)
+            queue->links[i] = i + 1 < queue->capacity ? (int) i + 1 : -1;
+        for (size_t i = 0; i < queue->levels; i++) {
+            queue->heads[i] = -1;
+            queue->tails[i] = -1;
+        }
+        queue->level_mask = 0;
+        queue->free_index = 0;
+    }
+
+}
+
+/// Allocate the message storage of a queue, with the level lists if
+/// it has message priorities, the queue must then be cleared.
+static int *process_queue_alloc_messages(size_t capacity, size_t levels) {
+
+    // Messages and links per slot, heads and tails per level.
+    size_t count = capacity;
+    if (levels != 0 && (__builtin_mul_overflow(capacity, 2, &count) || __builtin_add_overflow(count, levels * 2, &count)))
+        return NULL;
+
+    size_t messages_alloc;
+    if (__builtin_mul_overflow(sizeof(int), count, &messages_alloc))
+        return NULL;
+
+    return kalloc(messages_alloc);
+
+}
+
+/// Set the message storage of a queue, from 'process_queue_alloc_messages'.
+static void process_queue_set_messages(struct process_queue *queue, int *messages, size_t capacity) {
+    queue->messages = messages;
+    queue->capacity = capacity;
+    if (queue->levels != 0) {
+        queue->links = messages + capacity;
+        queue->heads = queue->links + capacity;
+        queue->tails = queue->heads + queue->levels;
+    }
+}
+
+/// Append a message to its level list (without checking if space is
+/// available).
+static void process_queue_level_write(struct process_queue *queue, int message, int priority) {
+
+    int index = queue->free_index;
+    queue->free_index = queue->links[index];
+    queue->messages[index] = message;
+    queue->links[index] = -1;
+
+    if (queue->tails[priority] < 0) {
+        queue->heads[priority] = index;
+    } else {
+        queue->links[queue->tails[priority]] = index;
+    }
+
+    queue->tails[priority] = index;
+    queue->level_mask |= 1u << priority;
+
+}
+
+/// Pop the oldest message of the highest non-empty level (without
+/// checking if a message is available).
+static int process_queue_level_read(struct process_queue *queue) {
+
+    int priority = 31 - __builtin_clz(queue->level_mask);
+    int index = queue->heads[priority];
+    int message = queue->messages[index];
+
+    queue->heads[priority] = queue->links[index];
+    if (queue->heads[priority] < 0) {
+        queue->tails[priority] = -1;
+        queue->level_mask &= ~(1u << priority);
+    }
+
+    queue->links[index] = queue->free_index;
+    queue->free_index = index;
+
+    return message;
+
+}
+
+/// Send a message to a queue (without checking if space is available),
+/// the priority is ignored for FIFO queues. It returns the previous
+/// length.
+static size_t process_queue_raw_write(struct process_queue *queue, int message, int priority) {
+    if (queue->levels != 0) {
+        process_queue_level_write(queue, message, priority);
+    } else {
+        queue->messages[queue->write_index] = message;
+        if (++queue->write_index == queue->capacity)
+            queue->write_index = 0;
+    }
     return queue->length++;
 }
 
 /// Receive a message from a queue (without checking if space is available).
 /// It returns the previous length.
 static size_t process_queue_raw_read(struct process_queue *queue, int *message) {
-    if (message != NULL)
-        *message = queue->messages[queue->read_index];
-    if (++queue->read_index == queue->capacity)
-        queue->read_index = 0;
+    if (queue->levels != 0) {
+        int level_message = process_queue_level_read(queue);
+        if (message != NULL)
+            *message = level_message;
+    } else {
+        if (message != NULL)
+            *message = queue->messages[queue->read_index];
+        if (++queue->read_index == queue->capacity)
+            queue->read_index = 0;
+    }
     return queue->length--;
 }
 
-qid_t process_queue_create(int capacity) {
+/// Send many messages to a queue (without checking if space is
+/// available), this is done with at most two copies in the ring.
+static void process_queue_raw_write_many(struct process_queue *queue, const int *messages, size_t count) {
+    if (queue->levels != 0) {
+        for (size_t i = 0; i < count; i++)
+            process_queue_raw_write(queue, messages[i], 0);
+        return;
+    }
+    size_t first = queue->capacity - queue->write_index;
+    if (first > count)
+        first = count;
+    memcpy(queue->messages + queue->write_index, messages, first * sizeof(int));
+    memcpy(queue->messages, messages + first, (count - first) * sizeof(int));
+    queue->write_index += count;
+    if (queue->write_index >= queue->capacity)
+        queue->write_index -= queue->capacity;
+    queue->length += count;
+}
+
+/// Receive many messages from a queue (without checking if enough
+/// messages are available), this is done with at most two copies.
+static void process_queue_raw_read_many(struct process_queue *queue, int *messages, size_t count) {
+    if (queue->levels != 0) {
+        for (size_t i = 0; i < count; i++)
+            process_queue_raw_read(queue, &messages[i]);
+        return;
+    }
+    size_t first = queue->capacity - queue->read_index;
+    if (first > count)
+        first = count;
+    memcpy(messages, queue->messages + queue->read_index, first * sizeof(int));
+    memcpy(messages + first, queue->messages, (count - first) * sizeof(int));
+    queue->read_index += count;
+    if (queue->read_index >= queue->capacity)
+        queue->read_index -= queue->capacity;
+    queue->length -= count;
+}
+
+/// Re-schedule a process that has been popped from the waiting list
+/// of a queue, the given message is returned to it if it was waiting
+/// for reading.
+static void process_queue_resume(struct process *process, int message) {
+    process->state = PROCESS_SCHED;
+    process->sched.wait_queue_reset = false;
+    process->sched.wait_timeout = false;
+    process->sched.wait_queue_message = message;
+    process_sched_ring_insert(process);
+}
+
+/// Same as 'process_queue_resume', but the active process is
+/// preempted if the process has a higher priority, and true is
+/// returned in this case.
+static bool process_queue_wake(struct process *process, int message) {
+
+    process_queue_resume(process, message);
+
+    if (process->priority > process_active->priority) {
+        process_sched_advance(process);
+        return true;
+    }
+
+    return false;
+
+}
+
+/// Common implementation of queue creation, with zero levels for a
+/// FIFO queue.
+static qid_t process_queue_create_levels(int capacity, int levels) {
 
 #if QUEUE_DEBUG
-    printf("[%s] process_queue_create(%d)\n", process_active->name, capacity);
+    printf("[%s] process_queue_create(%d, %d)\n", process_active->name, capacity, levels);
 #endif
 
-    if (capacity <= 0 || id_pool_empty(queue_id_pool))
-        return -1;
-
-    size_t messages_alloc;
-    if (__builtin_mul_overflow(sizeof(int), capacity, &messages_alloc))
+    if (capacity <= 0 || handle_table_full(&queue_table))
         return -1;
 
-    int *messages = kalloc(messages_alloc);
+    int *messages = process_queue_alloc_messages(capacity, levels);
     if (messages == NULL)
         return -1;
 
@@ -174,20 +348,36 @@ qid_t process_queue_create(int capacity) {
         return -1;
     }
 
-    queue->messages = messages;
-    queue->capacity = capacity;
-    queue->length = 0;
-    queue->read_index = 0;
-    queue->write_index = 0;
-    queue->wait_process = NULL;
-
-    queue->qid = id_pool_alloc(queue_id_pool);
-    queue_pool[queue->qid] = queue;
+    queue->levels = levels;
+    process_queue_set_messages(queue, messages, capacity);
+    process_queue_clear(queue);
+    INIT_LIST_HEAD(&queue->wait_list);
+    queue->wait_count = 0;
+    process_wait_object_init(&queue->receive_wait);
+    process_wait_object_init(&queue->send_wait);
+    INIT_LIST_HEAD(&queue->call_list);
+
+    queue->qid = handle_alloc(&queue_table, queue);
+    if (queue->qid < 0) {
+        kfree(messages);
+        kfree(queue);
+        return -1;
+    }
 
     return queue->qid;
 
 }
 
+qid_t process_queue_create(int capacity) {
+    return process_queue_create_levels(capacity, 0);
+}
+
+qid_t process_queue_create_prio(int capacity, int levels) {
+    if (levels <= 0 || levels > QUEUE_LEVELS_MAX)
+        return -1;
+    return process_queue_create_levels(capacity, levels);
+}
+
 int process_queue_delete(qid_t qid) {
 
 #if QUEUE_DEBUG
@@ -198,12 +388,9 @@ int process_queue_delete(qid_t qid) {
     if (queue == NULL)
         return -1;
 
-    struct process *process = queue->wait_process;
-
-    queue_pool[queue->qid] = NULL;
-    id_pool_free(queue_id_pool, queue->qid);
+    handle_free(&queue_table, queue->qid);
     
-    process_queue_resume_reset(&process);
+    process_queue_resume_reset(queue);
 
     kfree(queue->messages);
     kfree(queue);
@@ -212,24 +399,28 @@ int process_queue_delete(qid_t qid) {
 
 }
 
-int process_queue_send(qid_t qid, int message) {
+/// Common implementation of blocking and timed send.
+static int process_queue_send_until(qid_t qid, int message, int priority, const uint32_t *deadline) {
 
 #if QUEUE_DEBUG
-    printf("[%s] process_queue_send(%d, %d)\n", process_active->name, qid, message);
+    printf("[%s] process_queue_send(%d, %d, %d)\n", process_active->name, qid, message, priority);
 #endif
 
     struct process_queue *queue = process_queue_from_qid(qid);
     if (queue == NULL)
         return -1;
 
+    // FIFO queues only accept the priority 0.
+    if (priority < 0 || (size_t) priority >= (queue->levels != 0 ? queue->levels : 1))
+        return -1;
+
     if (queue->length == queue->capacity) {
 
 #if QUEUE_DEBUG
         printf("[%s] process_queue_send(...): length == capacity (%d)\n", process_active->name, queue->length);
 #endif
 
-        if (process_queue_wait(queue, message))
-            return -1;
+        return process_queue_wait(queue, message, priority, deadline);
 
     } else {
 
@@ -239,24 +430,16 @@ int process_queue_send(qid_t qid, int message) {
             // be for reading) then we re-schedule it.
             struct process *next_process = process_queue_pop_next(queue);
             if (next_process != NULL) {
-
-                next_process->state = PROCESS_SCHED;
-                next_process->sched.wait_queue_reset = false;
-                next_process->sched.wait_queue_message = message;
-
-                process_sched_ring_insert(next_process);
-
-                if (next_process->priority > process_active->priority) {
-                    process_sched_advance(next_process);
-                }
-
+                process_queue_wake(next_process, message);
                 return 0;
-
             }
 
         }
 
-        process_queue_raw_write(queue, message);
+        // Processes watching the queue only wait while it is empty.
+        if (process_queue_raw_write(queue, message, priority) == 0) {
+            process_wait_object_signal(&queue->receive_wait);
+        }
 
     }
 
@@ -264,13 +447,14 @@ int process_queue_send(qid_t qid, int message) {
 
 }
 
-int process_queue_receive(qid_t qid, int *message) {
+/// Common implementation of blocking and timed receive.
+static int process_queue_receive_until(qid_t qid, int *message, const uint32_t *deadline) {
 
 #if QUEUE_DEBUG
     printf("[%s] process_queue_receive(%d, %p)\n", process_active->name, qid, message);
 #endif
 
-    if (message != NULL && !process_check_user_ptr(message))
+    if (message != NULL && !process_check_user_range(message, sizeof(int)))
         return -1;
 
     struct process_queue *queue = process_queue_from_qid(qid);
@@ -283,8 +467,9 @@ int process_queue_receive(qid_t qid, int *message) {
         printf("[%s] process_queue_receive(...): length == 0\n", process_active->name);
 #endif
 
-        if (process_queue_wait(queue, 0))
-            return -1;
+        int ret = process_queue_wait(queue, 0, 0, deadline);
+        if (ret != 0)
+            return ret;
         
         // Directly receive the message.
         if (message != NULL) {
@@ -298,29 +483,417 @@ int process_queue_receive(qid_t qid, int *message) {
             // Queue was full, we get highest priority process and 
             // instantly write its message to the queue.
             struct process *next_process = process_queue_pop_next(queue);
-            if (next_process == NULL)
+            if (next_process == NULL) {
+                // Nobody is waiting to send, but some may be watching.
+                process_wait_object_signal(&queue->send_wait);
                 return 0;
+            }
 
 #if QUEUE_DEBUG
             printf("[%s] process_queue_receive(...): queue was full, receiving %d from %s\n", process_active->name, next_process->wait_queue.message, next_process->name);
 #endif
 
-            process_queue_raw_write(queue, next_process->wait_queue.message);
+            process_queue_raw_write(queue, next_process->wait_queue.message, next_process->wait_queue.message_priority);
+            process_queue_wake(next_process, -1);
+
+        }
 
-            next_process->state = PROCESS_SCHED;
-            next_process->sched.wait_queue_reset = false;
-            next_process->sched.wait_queue_message = -1;
+    }
 
-            process_sched_ring_insert(next_process);
+    return 0;
 
-            if (next_process->priority > process_active->priority) {
-                process_sched_advance(next_process);
+}
+
+int process_queue_send(qid_t qid, int message) {
+    return process_queue_send_until(qid, message, 0, NULL);
+}
+
+int process_queue_send_prio(qid_t qid, int message, int priority) {
+    return process_queue_send_until(qid, message, priority, NULL);
+}
+
+int process_queue_send_timed(qid_t qid, int message, uint32_t clock) {
+    return process_queue_send_until(qid, message, 0, &clock);
+}
+
+int process_queue_try_send(qid_t qid, int message, int priority) {
+    uint32_t deadline = 0;
+    return process_queue_send_until(qid, message, priority, &deadline);
+}
+
+int process_queue_receive(qid_t qid, int *message) {
+    return process_queue_receive_until(qid, message, NULL);
+}
+
+int process_queue_receive_timed(qid_t qid, int *message, uint32_t clock) {
+    return process_queue_receive_until(qid, message, &clock);
+}
+
+int process_queue_send_many(qid_t qid, const int *messages, int count) {
+
+#if QUEUE_DEBUG
+    printf("[%s] process_queue_send_many(%d, %p, %d)\n", process_active->name, qid, messages, count);
+#endif
+
+    if (count < 0 || !process_check_user_array(messages, count, sizeof(int)))
+        return -1;
+
+    int sent = 0;
+    while (sent < count) {
+
+        // The queue is looked up again after each scheduling point,
+        // because it may have been deleted while we were not running.
+        struct process_queue *queue = process_queue_from_qid(qid);
+        if (queue == NULL)
+            return sent > 0 ? sent : -1;
+
+        if (queue->length == queue->capacity) {
+
+            // Block with our next message, exactly like 'send', the
+            // receiving process will write it to the queue.
+            if (process_queue_wait(queue, messages[sent], 0, NULL))
+                return sent > 0 ? sent : -1;
+
+            sent++;
+
+        } else if (queue->length == 0 && queue->wait_count != 0) {
+
+            // Processes are waiting for reading, hand off messages
+            // directly to them, the higher priority process is
+            // scheduled immediately like a single 'send' would do.
+            struct process *next_process;
+            while (sent < count && (next_process = process_queue_pop_next(queue)) != NULL) {
+                if (process_queue_wake(next_process, messages[sent++]))
+                    break;
             }
 
+        } else {
+
+            // No process can be waiting here, copy as much as possible.
+            size_t available = queue->capacity - queue->length;
+            size_t copy_count = count - sent;
+            if (copy_count > available)
+                copy_count = available;
+
+            bool was_empty = queue->length == 0;
+            process_queue_raw_write_many(queue, messages + sent, copy_count);
+            sent += copy_count;
+
+            if (was_empty)
+                process_wait_object_signal(&queue->receive_wait);
+
         }
 
     }
 
+    return sent;
+
+}
+
+int process_queue_receive_many(qid_t qid, int *messages, int count, int min_count) {
+
+#if QUEUE_DEBUG
+    printf("[%s] process_queue_receive_many(%d, %p, %d, %d)\n", process_active->name, qid, messages, count, min_count);
+#endif
+
+    if (count < 0 || min_count < 0 || min_count > count)
+        return -1;
+    if (!process_check_user_array(messages, count, sizeof(int)))
+        return -1;
+
+    int received = 0;
+    while (received < count) {
+
+        struct process_queue *queue = process_queue_from_qid(qid);
+        if (queue == NULL)
+            return received > 0 ? received : -1;
+
+        if (queue->length == 0) {
+
+            if (received >= min_count)
+                break;
+
+            if (process_queue_wait(queue, 0, 0, NULL))
+                return received > 0 ? received : -1;
+
+            messages[received++] = process_active->sched.wait_queue_message;
+
+        } else if (queue->wait_count != 0) {
+
+            // Processes are waiting for writing (the queue is full), 
+            // each slot we free is immediately refilled with the 
+            // message of the highest priority writer, we do this one
+            // message at a time to keep the ordering of 'receive'.
+            process_queue_raw_read(queue, &messages[received++]);
+            struct process *next_process = process_queue_pop_next(queue);
+            process_queue_raw_write(queue, next_process->wait_queue.message, next_process->wait_queue.message_priority);
+            process_queue_wake(next_process, -1);
+
+        } else {
+
+            size_t copy_count = count - received;
+            if (copy_count > queue->length)
+                copy_count = queue->length;
+
+            bool was_full = queue->length == queue->capacity;
+            process_queue_raw_read_many(queue, messages + received, copy_count);
+            received += copy_count;
+
+            if (was_full)
+                process_wait_object_signal(&queue->send_wait);
+
+        }
+
+    }
+
+    return received;
+
+}
+
+/// Keep the highest priority process of the two.
+static void process_queue_keep_highest(struct process **highest_process, struct process *process) {
+    if (process != NULL && (*highest_process == NULL || process->priority > (*highest_process)->priority)) {
+        *highest_process = process;
+    }
+}
+
+int process_queue_offer(struct process_queue *queue, int message, bool drop_oldest, struct process **wake_process) {
+
+    if (queue->length == 0 && queue->wait_count != 0) {
+        struct process *next_process = process_queue_pop_next(queue);
+        process_queue_resume(next_process, message);
+        process_queue_keep_highest(wake_process, next_process);
+        return 0;
+    }
+
+    int ret = 0;
+    if (queue->length == queue->capacity) {
+        if (!drop_oldest)
+            return -1;
+        process_queue_raw_read(queue, NULL);
+        ret = 1;
+    }
+
+    if (process_queue_raw_write(queue, message, 0) == 0) {
+        process_queue_keep_highest(wake_process, process_wait_object_notify(&queue->receive_wait));
+    }
+
+    return ret;
+
+}
+
+int process_queue_resize(qid_t qid, int capacity) {
+
+#if QUEUE_DEBUG
+    printf("[%s] process_queue_resize(%d, %d)\n", process_active->name, qid, capacity);
+#endif
+
+    struct process_queue *queue = process_queue_from_qid(qid);
+    if (queue == NULL || capacity <= 0 || (size_t) capacity < queue->length)
+        return -1;
+
+    int *messages = process_queue_alloc_messages(capacity, queue->levels);
+    if (messages == NULL)
+        return -1;
+
+    size_t length = queue->length;
+    bool was_full = length == queue->capacity;
+
+    if (queue->levels != 0) {
+
+        // Level lists are copied in order, the new slots are not
+        // linked yet.
+        int *old_messages = queue->messages;
+        int *old_links = queue->links;
+        int *old_heads = queue->heads;
+
+        process_queue_set_messages(queue, messages, capacity);
+        process_queue_clear(queue);
+
+        for (size_t level = 0; level < queue->levels; level++) {
+            for (int index = old_heads[level]; index >= 0; index = old_links[index])
+                process_queue_raw_write(queue, old_messages[index], level);
+        }
+
+        kfree(old_messages);
+
+    } else {
+
+        // Messages are linearised at the start of the new ring, so
+        // their order is kept.
+        process_queue_raw_read_many(queue, messages, length);
+        kfree(queue->messages);
+
+        process_queue_set_messages(queue, messages, capacity);
+        queue->length = length;
+        queue->read_index = 0;
+        queue->write_index = length == (size_t) capacity ? 0 : length;
+
+    }
+
+    if (!was_full || length == queue->capacity)
+        return 0;
+
+    // Waiting processes, if any, were writers: their messages are
+    // moved to the new space in priority order. We only preempt after
+    // all of them are resumed.
+    struct process *wake_process = NULL;
+    while (queue->length < queue->capacity && queue->wait_count != 0) {
+        struct process *next_process = process_queue_pop_next(queue);
+        process_queue_raw_write(queue, next_process->wait_queue.message, next_process->wait_queue.message_priority);
+        process_queue_resume(next_process, -1);
+        if (wake_process == NULL)
+            wake_process = next_process;
+    }
+
+    if (queue->length < queue->capacity) {
+        struct process *watch_process = process_wait_object_notify(&queue->send_wait);
+        if (watch_process != NULL && (wake_process == NULL || watch_process->priority > wake_process->priority))
+            wake_process = watch_process;
+    }
+
+    if (wake_process != NULL && wake_process->priority > process_active->priority) {
+        process_sched_advance(wake_process);
+    }
+
+    return 0;
+
+}
+
+/// Pop the highest priority process of the call list if it has the
+/// given role (server or caller), or return null.
+static struct process *process_queue_call_pop(struct process_queue *queue, bool server) {
+    struct process *process = queue_top(&queue->call_list, struct process, wait_call.node);
+    if (process == NULL || process->wait_call.server != server)
+        return NULL;
+    queue_del(process, wait_call.node);
+    return process;
+}
+
+/// Put a caller in the reply list of the server, the caller must be
+/// removed from any other list.
+static void process_queue_call_accept(struct process *caller, struct process *server) {
+    caller->state = PROCESS_WAIT_REPLY;
+    caller->wait_reply.server = server;
+    INIT_LINK(&caller->wait_reply.node);
+    queue_add(caller, &server->reply_list, struct process, wait_reply.node, priority);
+}
+
+/// Put the active process, removed from its ring, in the call list of
+/// the queue.
+static void process_queue_call_wait(struct process_queue *queue, bool server, int message) {
+    process_active->state = PROCESS_WAIT_CALL;
+    process_active->wait_call.queue = queue;
+    process_active->wait_call.server = server;
+    process_active->wait_call.message = message;
+    INIT_LINK(&process_active->wait_call.node);
+    queue_add(process_active, &queue->call_list, struct process, wait_call.node, priority);
+}
+
+int process_queue_call(qid_t qid, int message, int *reply) {
+
+#if QUEUE_DEBUG
+    printf("[%s] process_queue_call(%d, %d, %p)\n", process_active->name, qid, message, reply);
+#endif
+
+    if (reply != NULL && !process_check_user_range(reply, sizeof(int)))
+        return -1;
+
+    struct process_queue *queue = process_queue_from_qid(qid);
+    if (queue == NULL)
+        return -1;
+
+    struct process *next_process = process_sched_ring_remove(process_active);
+    struct process *server = process_queue_call_pop(queue, true);
+
+    if (server != NULL) {
+
+        // A server is waiting, it gets the message and we directly
+        // switch to it, instead of the next process of the ring, unless
+        // this would run a lower priority process before others.
+        server->state = PROCESS_SCHED;
+        server->sched.wait_queue_reset = false;
+        server->sched.wait_queue_message = message;
+        server->sched.wait_call_pid = process_active->pid;
+        process_sched_ring_insert(server);
+
+        process_queue_call_accept(process_active, server);
+
+        if (server->priority >= process_active->priority)
+            next_process = server;
+
+    } else {
+        process_queue_call_wait(queue, false, message);
+    }
+
+    process_sched_advance(next_process);
+
+    if (process_active->sched.wait_queue_reset)
+        return -1;
+
+    if (reply != NULL)
+        *reply = process_active->sched.wait_queue_message;
+
+    return 0;
+
+}
+
+pid_t process_queue_receive_call(qid_t qid, int *message) {
+
+#if QUEUE_DEBUG
+    printf("[%s] process_queue_receive_call(%d, %p)\n", process_active->name, qid, message);
+#endif
+
+    if (message != NULL && !process_check_user_range(message, sizeof(int)))
+        return -1;
+
+    struct process_queue *queue = process_queue_from_qid(qid);
+    if (queue == NULL)
+        return -1;
+
+    struct process *caller = process_queue_call_pop(queue, false);
+    if (caller != NULL) {
+        if (message != NULL)
+            *message = caller->wait_call.message;
+        process_queue_call_accept(caller, process_active);
+        return caller->pid;
+    }
+
+    struct process *next_process = process_sched_ring_remove(process_active);
+    process_queue_call_wait(queue, true, 0);
+    process_sched_advance(next_process);
+
+    if (process_active->sched.wait_queue_reset)
+        return -1;
+
+    if (message != NULL)
+        *message = process_active->sched.wait_queue_message;
+
+    return process_active->sched.wait_call_pid;
+
+}
+
+int process_queue_reply(pid_t pid, int message) {
+
+#if QUEUE_DEBUG
+    printf("[%s] process_queue_reply(%d, %d)\n", process_active->name, pid, message);
+#endif
+
+    struct process *caller = process_from_pid(pid);
+    if (caller == NULL || caller->state != PROCESS_WAIT_REPLY || caller->wait_reply.server != process_active)
+        return -1;
+
+    queue_del(caller, wait_reply.node);
+
+    caller->state = PROCESS_SCHED;
+    caller->sched.wait_queue_reset = false;
+    caller->sched.wait_queue_message = message;
+    process_sched_ring_insert(caller);
+
+    // Switch straight back to the caller, we stay in our ring.
+    if (caller->priority >= process_active->priority)
+        process_sched_advance(caller);
+
     return 0;
 
 }
@@ -331,7 +904,7 @@ int process_queue_count(qid_t qid, int *count) {
     printf("[%s] process_queue_count(%d, %p)\n", process_active->name, qid, count);
 #endif
 
-    if (count != NULL && !process_check_user_ptr(count))
+    if (count != NULL && !process_check_user_range(count, sizeof(int)))
         return -1;
 
     struct process_queue *queue = process_queue_from_qid(qid);
@@ -341,12 +914,7 @@ int process_queue_count(qid_t qid, int *count) {
     if (count == NULL)
         return 0;
 
-    int waiting_count = 0;
-    struct process *waiting_process = queue->wait_process;
-    while (waiting_process != NULL) {
-        waiting_count++;
-        waiting_process = waiting_process->wait_queue.next;
-    }
+    int waiting_count = queue->wait_count;
 
 #if QUEUE_DEBUG
     printf("[%s] process_queue_count(...): waiting_process = %d, len = %d\n", process_active->name, waiting_count, queue->length);
@@ -381,11 +949,28 @@ int process_queue_reset(qid_t qid) {
     if (queue == NULL)
         return -1;
 
-    queue->length = 0;
-    queue->read_index = 0;
-    queue->write_index = 0;
+    process_queue_clear(queue);
+    process_queue_resume_reset(queue);
+
+    return 0;
 
-    process_queue_resume_reset(&queue->wait_process);
+}
+
+int process_queue_watch(qid_t qid, bool send, struct process_wait_object **object) {
+
+    struct process_queue *queue = process_queue_from_qid(qid);
+    if (queue == NULL)
+        return -1;
+
+    if (send) {
+        if (queue->length < queue->capacity)
+            return 1;
+        *object = &queue->send_wait;
+    } else {
+        if (queue->length > 0)
+            return 1;
+        *object = &queue->receive_wait;
+    }
 
     return 0;
 
@@ -403,4 +988,51 @@ void process_queue_set_priority(struct process *process, int new_priority) {
 
 void process_queue_kill_process(struct process *process) {
     process_queue_remove_process(process->wait_queue.queue, process);
+    process_time_queue_remove(process);
+}
+
+void process_queue_timeout_process(struct process *process) {
+
+    process_queue_remove_process(process->wait_queue.queue, process);
+
+    process->state = PROCESS_SCHED;
+    process->sched.wait_queue_reset = false;
+    process->sched.wait_timeout = true;
+    process_sched_ring_insert(process);
+
+}
+
+void process_queue_call_set_priority(struct process *process, int new_priority) {
+
+    process->priority = new_priority;
+
+    if (process->state == PROCESS_WAIT_CALL) {
+        queue_del(process, wait_call.node);
+        queue_add(process, &process->wait_call.queue->call_list, struct process, wait_call.node, priority);
+    } else {
+        queue_del(process, wait_reply.node);
+        queue_add(process, &process->wait_reply.server->reply_list, struct process, wait_reply.node, priority);
+    }
+
+}
+
+void process_queue_call_kill_process(struct process *process) {
+    if (process->state == PROCESS_WAIT_CALL) {
+        queue_del(process, wait_call.node);
+    } else {
+        queue_del(process, wait_reply.node);
+    }
+}
+
+void process_queue_call_kill_server(struct process *process) {
+
+    // Callers are only re-scheduled because we are in the middle of a
+    // kill.
+    struct process *caller;
+    while ((caller = queue_out(&process->reply_list, struct process, wait_reply.node)) != NULL) {
+        caller->state = PROCESS_SCHED;
+        caller->sched.wait_queue_reset = true;
+        process_sched_ring_insert(caller);
+    }
+
 }
@@ -0,0 +1,207 @@
+/// Syscall rings, a process queues operations in a submission ring in
+/// its own memory and executes a batch of them with a single syscall,
+/// results are posted to a completion ring.
+
+#include "internals.h"
+
+#include "process.h"
+#include "pit.h"
+
+#include "stdio.h"
+
+
+// Maximum number of entries of a ring.
+#define RING_SIZE_MAX 4096
+
+/// Handlers are called with all five arguments, the CDECL calling
+/// convention allows handlers that take less.
+typedef int (*ring_handler_t)(uint32_t, uint32_t, uint32_t, uint32_t, uint32_t);
+
+
+/// Check that the registered ring is still accessible, it may have
+/// been placed in a shared memory object that is now detached.
+static bool process_ring_check(struct process_ring *ring) {
+    size_t size = ring->mask + 1;
+    return process_check_user_range(ring->ring, sizeof(struct syscall_ring))
+        && process_check_user_range(ring->sq, size * sizeof(struct syscall_ring_sqe))
+        && process_check_user_range(ring->cq, size * sizeof(struct syscall_ring_cqe));
+}
+
+/// Execute a syscall that may block in its non-blocking form, an
+/// entry never blocks the submitting process so it can't stall the
+/// rest of the batch. 'SYSCALL_WOULD_BLOCK' is returned where the
+/// syscall would have blocked, and -1 if it has no such form.
+static int process_ring_call_nonblocking(uint32_t num, const uint32_t *args) {
+
+    struct process_wait_object *object;
+    int ready;
+
+    switch (num) {
+    case SC_PROCESS_WAIT:
+        ready = process_child_watch((pid_t) args[0], &object);
+        if (ready <= 0)
+            return ready < 0 ? -1 : SYSCALL_WOULD_BLOCK;
+        return process_wait((pid_t) args[0], (int *) args[1]);
+    case SC_PROCESS_WAIT_CLOCK:
+        if (args[0] > pit_clock_get())
+            return SYSCALL_WOULD_BLOCK;
+        process_wait_clock(args[0]);
+        return 0;
+    case SC_PROCESS_QUEUE_SEND:
+    case SC_PROCESS_QUEUE_SEND_TIMED:
+        return process_queue_try_send((qid_t) args[0], (int) args[1], 0);
+    case SC_PROCESS_QUEUE_SEND_PRIO:
+        return process_queue_try_send((qid_t) args[0], (int) args[1], (int) args[2]);
+    case SC_PROCESS_QUEUE_RECEIVE:
+    case SC_PROCESS_QUEUE_RECEIVE_TIMED:
+        return process_queue_receive_timed((qid_t) args[0], (int *) args[1], 0);
+    case SC_PROCESS_SEM_WAIT:
+        return process_sem_try_wait((semid_t) args[0]);
+    case SC_PROCESS_MUTEX_LOCK:
+        return process_mutex_try_lock((mutexid_t) args[0]);
+    case SC_CONSOLE_READ:
+        ready = process_cons_read_watch(&object);
+        if (ready <= 0)
+            return ready < 0 ? -1 : SYSCALL_WOULD_BLOCK;
+        return process_wait_cons_read((char *) args[0], args[1]);
+    default:
+        return -1;
+    }
+
+}
+
+/// Execute a submission entry, the ring syscalls themselves can't be
+/// submitted.
+static int process_ring_call(const struct syscall_ring_sqe *sqe) {
+
+    uint32_t num = sqe->num;
+    if (num >= SYSCALL_COUNT || num == SC_PROCESS_RING_SETUP || num == SC_PROCESS_RING_SUBMIT)
+        return -1;
+
+    const uint32_t *args = sqe->args;
+    uint64_t start = __builtin_ia32_rdtsc();
+    int ret;
+
+    switch (num) {
+    case SC_PROCESS_WAIT:
+    case SC_PROCESS_WAIT_CLOCK:
+    case SC_PROCESS_WAIT_ANY:
+    case SC_PROCESS_FUTEX_WAIT:
+    case SC_PROCESS_QUEUE_SEND:
+    case SC_PROCESS_QUEUE_RECEIVE:
+    case SC_PROCESS_QUEUE_SEND_MANY:
+    case SC_PROCESS_QUEUE_RECEIVE_MANY:
+    case SC_PROCESS_QUEUE_SEND_TIMED:
+    case SC_PROCESS_QUEUE_RECEIVE_TIMED:
+    case SC_PROCESS_QUEUE_CALL:
+    case SC_PROCESS_QUEUE_RECEIVE_CALL:
+    case SC_PROCESS_QUEUE_SEND_PRIO:
+    case SC_PROCESS_TOPIC_PUBLISH:
+    case SC_PROCESS_DGRAM_SEND:
+    case SC_PROCESS_DGRAM_RECEIVE:
+    case SC_PROCESS_SEM_WAIT:
+    case SC_PROCESS_MUTEX_LOCK:
+    case SC_PROCESS_COND_WAIT:
+    case SC_PROCESS_BARRIER_WAIT:
+    case SC_CONSOLE_READ:
+        ret = process_ring_call_nonblocking(num, args);
+        break;
+    default: {
+        ring_handler_t handler = (ring_handler_t) syscall_handlers[num];
+        ret = handler(args[0], args[1], args[2], args[3], args[4]);
+        break;
+    }
+    }
+
+    syscall_stats_count[num]++;
+    syscall_stats_cycles[num] += __builtin_ia32_rdtsc() - start;
+
+    return ret;
+
+}
+
+int process_ring_setup(struct syscall_ring *ring) {
+
+    struct process_ring *process_ring = &process_active->ring;
+
+    if (ring == NULL) {
+        process_ring->ring = NULL;
+        return 0;
+    }
+
+    if (!process_check_user_range(ring, sizeof(struct syscall_ring)))
+        return -1;
+
+    uint32_t size = ring->size;
+    if (size == 0 || size > RING_SIZE_MAX || (size & (size - 1)) != 0)
+        return -1;
+
+    // The layout is copied, the user can't change it afterward.
+    struct process_ring new_ring = {
+        .ring = ring,
+        .sq = ring->sq,
+        .cq = ring->cq,
+        .mask = size - 1,
+        .cancel = false,
+    };
+
+    if (!process_ring_check(&new_ring))
+        return -1;
+
+    *process_ring = new_ring;
+    return 0;
+
+}
+
+int process_ring_submit(int count) {
+
+    struct process_ring *process_ring = &process_active->ring;
+    if (count < 0 || process_ring->ring == NULL)
+        return -1;
+
+    int done = 0;
+
+    while (done < count) {
+
+        // Checked again after each entry because the previous one may
+        // have detached the memory of the ring.
+        if (!process_ring_check(process_ring))
+            return done == 0 ? -1 : done;
+
+        struct syscall_ring *ring = process_ring->ring;
+        if (ring->sq_head == ring->sq_tail)
+            break;
+
+        // Results are never dropped, the user must consume them.
+        if (ring->cq_tail - ring->cq_head > process_ring->mask)
+            break;
+
+        struct syscall_ring_sqe *sqe = &process_ring->sq[ring->sq_head & process_ring->mask];
+        uint32_t user_data = sqe->user_data;
+        bool link = (sqe->flags & SYSCALL_RING_LINK) != 0;
+
+        // Entries are executed synchronously but never block, see
+        // 'process_ring_call_nonblocking'.
+        int ret = process_ring->cancel ? SYSCALL_CANCELED : process_ring_call(sqe);
+
+        // The chain state is kept in the kernel, so it continues in
+        // the next batch if this one ends in the middle.
+        process_ring->cancel = link && ret < 0;
+
+        // The entry is executed but its result can't be posted.
+        if (!process_ring_check(process_ring))
+            return done + 1;
+
+        struct syscall_ring_cqe *cqe = &process_ring->cq[ring->cq_tail & process_ring->mask];
+        cqe->user_data = user_data;
+        cqe->ret = ret;
+
+        ring->cq_tail++;
+        ring->sq_head++;
+        done++;
+
+    }
+
+    return done;
+
+}
@@ -1,4 +1,5 @@
 #include "internals.h"
+#include "vdso.h"
 
 #include "stdio.h"
 #include "cpu.h"
@@ -160,6 +161,7 @@ void process_sched_advance(struct process *next_process) {
     } else {
         struct process *prev_process = process_active;
         process_active = next_process;
+        vdso_set_pid(next_process->pid);
         process_context_switch(prev_process, next_process);
     }
 
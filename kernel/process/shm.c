@@ -0,0 +1,175 @@
+/// Shared memory objects, backed by kernel pages that are mapped in
+/// the user mapping window while attached by at least one process.
+
+#include "internals.h"
+
+#include "process.h"
+#include "memory.h"
+#include "pool.h"
+
+#include "stdio.h"
+#include "string.h"
+
+
+#define SHM_POOL_CAP 64
+
+static id_pool_t(SHM_POOL_CAP) shm_id_pool = { 0 };
+static struct process_shm *shm_pool[SHM_POOL_CAP] = { 0 };
+
+
+/// Get a shared memory object from its ID, while checking the
+/// validity of the ID.
+static struct process_shm *process_shm_from_id(shmid_t id) {
+    if (id < 0 || id >= SHM_POOL_CAP) {
+        return NULL;
+    } else {
+        return shm_pool[id];
+    }
+}
+
+/// Free the object's pages and the object itself.
+static void process_shm_free(struct process_shm *shm) {
+    page_free(shm->pages, shm->size);
+    kfree(shm);
+}
+
+/// Remove the given number of attachments of a process, the
+/// attachment is freed if it reaches zero, and the object is unmapped
+/// (and freed if destroyed) if no process has it attached anymore.
+static void process_shm_detach_count(struct process *process, struct process_shm_attach **attach_ptr, size_t count) {
+
+    struct process_shm_attach *attach = *attach_ptr;
+    struct process_shm *shm = attach->shm;
+
+    attach->count -= count;
+    shm->attach_count -= count;
+
+    if (attach->count == 0) {
+        *attach_ptr = attach->next;
+        process->shm_size -= shm->size;
+        kfree(attach);
+    }
+
+    if (shm->attach_count == 0) {
+        page_unmap_user(shm->addr, shm->size);
+        shm->addr = NULL;
+        if (shm->destroyed)
+            process_shm_free(shm);
+    }
+
+}
+
+shmid_t process_shm_create(int size) {
+
+    if (size <= 0 || id_pool_empty(shm_id_pool))
+        return -1;
+
+    void *pages = page_alloc(size);
+    if (pages == NULL)
+        return -1;
+
+    struct process_shm *shm = kalloc(sizeof(struct process_shm));
+    if (shm == NULL) {
+        page_free(pages, size);
+        return -1;
+    }
+
+    // Pages may contain data of previous owners.
+    memset(pages, 0, size);
+
+    shm->pages = pages;
+    shm->size = size;
+    shm->addr = NULL;
+    shm->attach_count = 0;
+    shm->destroyed = false;
+
+    shm->id = id_pool_alloc(shm_id_pool);
+    shm_pool[shm->id] = shm;
+
+    return shm->id;
+
+}
+
+void *process_shm_attach(shmid_t id) {
+
+    struct process_shm *shm = process_shm_from_id(id);
+    if (shm == NULL)
+        return NULL;
+
+    // Find if the process already has the object attached.
+    struct process_shm_attach *attach = process_active->shm_attach;
+    while (attach != NULL && attach->shm != shm)
+        attach = attach->next;
+
+    if (attach == NULL) {
+
+        attach = kalloc(sizeof(struct process_shm_attach));
+        if (attach == NULL)
+            return NULL;
+
+        attach->shm = shm;
+        attach->count = 0;
+
+    }
+
+    // All processes share the same mapping, done on first attachment.
+    if (shm->addr == NULL) {
+        shm->addr = page_map_user(shm->pages, shm->size);
+        if (shm->addr == NULL) {
+            if (attach->count == 0)
+                kfree(attach);
+            return NULL;
+        }
+    }
+
+    if (attach->count == 0) {
+        attach->next = process_active->shm_attach;
+        process_active->shm_attach = attach;
+        process_active->shm_size += shm->size;
+    }
+
+    attach->count++;
+    shm->attach_count++;
+
+    return shm->addr;
+
+}
+
+int process_shm_detach(void *addr) {
+
+    struct process_shm_attach **attach_ptr = &process_active->shm_attach;
+    while (*attach_ptr != NULL) {
+        if ((*attach_ptr)->shm->addr == addr) {
+            process_shm_detach_count(process_active, attach_ptr, 1);
+            return 0;
+        }
+        attach_ptr = &(*attach_ptr)->next;
+    }
+
+    return -1;
+
+}
+
+int process_shm_destroy(shmid_t id) {
+
+    struct process_shm *shm = process_shm_from_id(id);
+    if (shm == NULL)
+        return -1;
+
+    shm_pool[shm->id] = NULL;
+    id_pool_free(shm_id_pool, shm->id);
+
+    // Attached processes keep their mapping until they detach.
+    shm->destroyed = true;
+    if (shm->attach_count == 0)
+        process_shm_free(shm);
+
+    return 0;
+
+}
+
+void process_shm_kill_process(struct process *process) {
+    while (process->shm_attach != NULL) {
+        process_shm_detach_count(process, &process->shm_attach, process->shm_attach->count);
+    }
+}
@@ -0,0 +1,547 @@
+/// Kernel synchronization objects: counting semaphores, mutexes,
+/// condition variables and barriers. They share the waiting list
+/// logic of queues: processes are woken up in priority order, FIFO for
+/// equal priorities, and return -1 if the object is reset or deleted.
+
+#include "internals.h"
+
+#include "process.h"
+#include "memory.h"
+#include "pool.h"
+
+#include "stdio.h"
+
+
+#define SYNC_POOL_CAP 256
+
+static id_pool_t(SYNC_POOL_CAP) sem_id_pool = { 0 };
+static struct process_sync *sem_pool[SYNC_POOL_CAP] = { 0 };
+static id_pool_t(SYNC_POOL_CAP) mutex_id_pool = { 0 };
+static struct process_sync *mutex_pool[SYNC_POOL_CAP] = { 0 };
+static id_pool_t(SYNC_POOL_CAP) cond_id_pool = { 0 };
+static struct process_sync *cond_pool[SYNC_POOL_CAP] = { 0 };
+static id_pool_t(SYNC_POOL_CAP) barrier_id_pool = { 0 };
+static struct process_sync *barrier_pool[SYNC_POOL_CAP] = { 0 };
+
+
+/// Get an object from its ID in the given pool, while checking the
+/// validity of the ID.
+static struct process_sync *process_sync_from_id(struct process_sync **pool, int id) {
+    if (id < 0 || id >= SYNC_POOL_CAP) {
+        return NULL;
+    } else {
+        return pool[id];
+    }
+}
+
+/// Allocate a new object, the ID must be allocated by the caller.
+static struct process_sync *process_sync_alloc(enum process_sync_kind kind) {
+
+    struct process_sync *sync = kalloc(sizeof(struct process_sync));
+    if (sync == NULL)
+        return NULL;
+
+    sync->kind = kind;
+    INIT_LIST_HEAD(&sync->wait_list);
+    sync->wait_count = 0;
+
+    return sync;
+
+}
+
+/// Add the given process to the object's waiting list, in priority
+/// order. The process must be in WAIT_SYNC state.
+static void process_sync_add_process(struct process_sync *sync, struct process *process) {
+    process->wait_sync.sync = sync;
+    INIT_LINK(&process->wait_sync.node);
+    queue_add(process, &sync->wait_list, struct process, wait_sync.node, priority);
+    sync->wait_count++;
+}
+
+/// Remove the given process from the object's waiting list.
+static void process_sync_remove_process(struct process_sync *sync, struct process *process) {
+    queue_del(process, wait_sync.node);
+    sync->wait_count--;
+}
+
+/// Pop the waiting process with the highest priority, the oldest one
+/// if several have the same priority.
+static struct process *process_sync_pop_next(struct process_sync *sync) {
+
+    struct process *process = queue_out(&sync->wait_list, struct process, wait_sync.node);
+    if (process != NULL)
+        sync->wait_count--;
+
+    return process;
+
+}
+
+/// Re-schedule a process popped from a waiting list, with the status
+/// that its wait will return.
+static void process_sync_wake(struct process *process, int status) {
+    process->state = PROCESS_SCHED;
+    process->sched.wait_sync_status = status;
+    process_sched_ring_insert(process);
+}
+
+/// Schedule the given process if it has priority over the active one.
+static void process_sync_preempt(struct process *process) {
+    if (process != NULL && process->priority > process_active->priority) {
+        process_sched_advance(process);
+    }
+}
+
+/// Put the active process in wait state for the given object. The
+/// given process (if not null) is scheduled instead of the next one
+/// of the ring if it has priority. The mutex ID is only used for
+/// condition variables. Returns the wait status.
+static int process_sync_wait(struct process_sync *sync, struct process *wake_process, mutexid_t mutex_id) {
+
+    struct process *next_process = process_sched_ring_remove(process_active);
+    if (wake_process != NULL && wake_process->priority > process_active->priority)
+        next_process = wake_process;
+
+    process_active->state = PROCESS_WAIT_SYNC;
+    process_active->wait_sync.mutex_id = mutex_id;
+    process_sync_add_process(sync, process_active);
+
+    process_sched_advance(next_process);
+
+    return process_active->sched.wait_sync_status;
+
+}
+
+/// Wake all waiting processes with the given status, the highest
+/// priority one is returned.
+static struct process *process_sync_resume_all(struct process_sync *sync, int status) {
+
+    struct process *wake_process = process_sync_pop_next(sync);
+    struct process *wait_process = wake_process;
+
+    while (wait_process != NULL) {
+        process_sync_wake(wait_process, status);
+        wait_process = process_sync_pop_next(sync);
+    }
+
+    return wake_process;
+
+}
+
+/// Release a mutex, its ownership is directly given to the highest
+/// priority waiting process, which is returned.
+static struct process *process_mutex_release(struct process_sync *mutex) {
+
+    struct process *next_process = process_sync_pop_next(mutex);
+    mutex->mutex.owner = next_process;
+
+    if (next_process != NULL)
+        process_sync_wake(next_process, 0);
+
+    return next_process;
+
+}
+
+/// Give the mutex to a process that was waiting on a condition, or
+/// make it wait for the mutex. Returns the process if woken up.
+static struct process *process_cond_requeue(struct process *process) {
+
+    struct process_sync *mutex = process_sync_from_id(mutex_pool, process->wait_sync.mutex_id);
+
+    if (mutex == NULL) {
+        process_sync_wake(process, -1);
+        return process;
+    } else if (mutex->mutex.owner == NULL) {
+        mutex->mutex.owner = process;
+        process_sync_wake(process, 0);
+        return process;
+    } else {
+        // Still in WAIT_SYNC state, but now for the mutex.
+        process_sync_add_process(mutex, process);
+        return NULL;
+    }
+
+}
+
+/// Common end of delete functions, once the object has been removed
+/// from its pool: all waiting processes return -1.
+static void process_sync_destroy(struct process_sync *sync) {
+    struct process *wake_process = process_sync_resume_all(sync, -1);
+    kfree(sync);
+    process_sync_preempt(wake_process);
+}
+
+// Semaphores
+
+semid_t process_sem_create(int count) {
+
+    if (count < 0 || id_pool_empty(sem_id_pool))
+        return -1;
+
+    struct process_sync *sem = process_sync_alloc(PROCESS_SYNC_SEM);
+    if (sem == NULL)
+        return -1;
+
+    sem->sem.count = count;
+    sem->id = id_pool_alloc(sem_id_pool);
+    sem_pool[sem->id] = sem;
+
+    return sem->id;
+
+}
+
+int process_sem_delete(semid_t id) {
+
+    struct process_sync *sem = process_sync_from_id(sem_pool, id);
+    if (sem == NULL)
+        return -1;
+
+    sem_pool[id] = NULL;
+    id_pool_free(sem_id_pool, id);
+
+    process_sync_destroy(sem);
+    return 0;
+
+}
+
+int process_sem_wait(semid_t id) {
+
+    struct process_sync *sem = process_sync_from_id(sem_pool, id);
+    if (sem == NULL)
+        return -1;
+
+    if (sem->sem.count > 0) {
+        sem->sem.count--;
+        return 0;
+    }
+
+    return process_sync_wait(sem, NULL, -1);
+
+}
+
+int process_sem_try_wait(semid_t id) {
+
+    struct process_sync *sem = process_sync_from_id(sem_pool, id);
+    if (sem == NULL)
+        return -1;
+
+    if (sem->sem.count > 0) {
+        sem->sem.count--;
+        return 0;
+    }
+
+    return SYSCALL_WOULD_BLOCK;
+
+}
+
+int process_sem_signal(semid_t id, int count) {
+
+    struct process_sync *sem = process_sync_from_id(sem_pool, id);
+    if (sem == NULL || count <= 0)
+        return -1;
+
+    // Each signal is directly given to a waiting process if any, the
+    // first woken up has the highest priority.
+    struct process *wake_process = NULL;
+    for (; count > 0; count--) {
+
+        struct process *next_process = process_sync_pop_next(sem);
+        if (next_process == NULL)
+            break;
+
+        process_sync_wake(next_process, 0);
+        if (wake_process == NULL)
+            wake_process = next_process;
+
+    }
+
+    if (__builtin_add_overflow(sem->sem.count, count, &sem->sem.count))
+        sem->sem.count = 0x7FFFFFFF;
+
+    process_sync_preempt(wake_process);
+    return 0;
+
+}
+
+int process_sem_count(semid_t id) {
+
+    struct process_sync *sem = process_sync_from_id(sem_pool, id);
+    if (sem == NULL)
+        return -1;
+
+    // Negative number of waiting processes if any.
+    if (sem->wait_count != 0)
+        return -(int) sem->wait_count;
+
+    return sem->sem.count;
+
+}
+
+int process_sem_reset(semid_t id, int count) {
+
+    struct process_sync *sem = process_sync_from_id(sem_pool, id);
+    if (sem == NULL || count < 0)
+        return -1;
+
+    sem->sem.count = count;
+    process_sync_preempt(process_sync_resume_all(sem, -1));
+    return 0;
+
+}
+
+// Mutexes
+
+mutexid_t process_mutex_create(void) {
+
+    if (id_pool_empty(mutex_id_pool))
+        return -1;
+
+    struct process_sync *mutex = process_sync_alloc(PROCESS_SYNC_MUTEX);
+    if (mutex == NULL)
+        return -1;
+
+    mutex->mutex.owner = NULL;
+    mutex->id = id_pool_alloc(mutex_id_pool);
+    mutex_pool[mutex->id] = mutex;
+
+    return mutex->id;
+
+}
+
+int process_mutex_delete(mutexid_t id) {
+
+    struct process_sync *mutex = process_sync_from_id(mutex_pool, id);
+    if (mutex == NULL)
+        return -1;
+
+    mutex_pool[id] = NULL;
+    id_pool_free(mutex_id_pool, id);
+
+    process_sync_destroy(mutex);
+    return 0;
+
+}
+
+int process_mutex_lock(mutexid_t id) {
+
+    struct process_sync *mutex = process_sync_from_id(mutex_pool, id);
+    if (mutex == NULL || mutex->mutex.owner == process_active)
+        return -1;
+
+    if (mutex->mutex.owner == NULL) {
+        mutex->mutex.owner = process_active;
+        return 0;
+    }
+
+    // When resuming with success, the ownership has been given to us.
+    return process_sync_wait(mutex, NULL, -1);
+
+}
+
+int process_mutex_try_lock(mutexid_t id) {
+
+    struct process_sync *mutex = process_sync_from_id(mutex_pool, id);
+    if (mutex == NULL || mutex->mutex.owner == process_active)
+        return -1;
+
+    if (mutex->mutex.owner == NULL) {
+        mutex->mutex.owner = process_active;
+        return 0;
+    }
+
+    return SYSCALL_WOULD_BLOCK;
+
+}
+
+int process_mutex_unlock(mutexid_t id) {
+
+    struct process_sync *mutex = process_sync_from_id(mutex_pool, id);
+    if (mutex == NULL || mutex->mutex.owner != process_active)
+        return -1;
+
+    process_sync_preempt(process_mutex_release(mutex));
+    return 0;
+
+}
+
+// Condition variables
+
+condid_t process_cond_create(void) {
+
+    if (id_pool_empty(cond_id_pool))
+        return -1;
+
+    struct process_sync *cond = process_sync_alloc(PROCESS_SYNC_COND);
+    if (cond == NULL)
+        return -1;
+
+    cond->id = id_pool_alloc(cond_id_pool);
+    cond_pool[cond->id] = cond;
+
+    return cond->id;
+
+}
+
+int process_cond_delete(condid_t id) {
+
+    struct process_sync *cond = process_sync_from_id(cond_pool, id);
+    if (cond == NULL)
+        return -1;
+
+    cond_pool[id] = NULL;
+    id_pool_free(cond_id_pool, id);
+
+    process_sync_destroy(cond);
+    return 0;
+
+}
+
+int process_cond_wait(condid_t id, mutexid_t mutex_id) {
+
+    struct process_sync *cond = process_sync_from_id(cond_pool, id);
+    struct process_sync *mutex = process_sync_from_id(mutex_pool, mutex_id);
+    if (cond == NULL || mutex == NULL || mutex->mutex.owner != process_active)
+        return -1;
+
+    // Releasing the mutex and waiting is atomic, because the kernel
+    // is not interruptible.
+    struct process *wake_process = process_mutex_release(mutex);
+
+    // When signaled, we are moved to the mutex's waiting list and the
+    // ownership is given to us before resuming.
+    return process_sync_wait(cond, wake_process, mutex_id);
+
+}
+
+int process_cond_signal(condid_t id) {
+
+    struct process_sync *cond = process_sync_from_id(cond_pool, id);
+    if (cond == NULL)
+        return -1;
+
+    struct process *next_process = process_sync_pop_next(cond);
+    if (next_process != NULL)
+        process_sync_preempt(process_cond_requeue(next_process));
+
+    return 0;
+
+}
+
+int process_cond_broadcast(condid_t id) {
+
+    struct process_sync *cond = process_sync_from_id(cond_pool, id);
+    if (cond == NULL)
+        return -1;
+
+    // At most one process can get the mutex, others are moved to its
+    // waiting list.
+    struct process *wake_process = NULL;
+    struct process *next_process;
+    while ((next_process = process_sync_pop_next(cond)) != NULL) {
+        struct process *woken_process = process_cond_requeue(next_process);
+        if (woken_process != NULL && (wake_process == NULL || woken_process->priority > wake_process->priority))
+            wake_process = woken_process;
+    }
+
+    process_sync_preempt(wake_process);
+    return 0;
+
+}
+
+// Barriers
+
+barrierid_t process_barrier_create(int count) {
+
+    if (count <= 0 || id_pool_empty(barrier_id_pool))
+        return -1;
+
+    struct process_sync *barrier = process_sync_alloc(PROCESS_SYNC_BARRIER);
+    if (barrier == NULL)
+        return -1;
+
+    barrier->barrier.count = count;
+    barrier->barrier.arrived = 0;
+    barrier->id = id_pool_alloc(barrier_id_pool);
+    barrier_pool[barrier->id] = barrier;
+
+    return barrier->id;
+
+}
+
+int process_barrier_delete(barrierid_t id) {
+
+    struct process_sync *barrier = process_sync_from_id(barrier_pool, id);
+    if (barrier == NULL)
+        return -1;
+
+    barrier_pool[id] = NULL;
+    id_pool_free(barrier_id_pool, id);
+
+    process_sync_destroy(barrier);
+    return 0;
+
+}
+
+int process_barrier_wait(barrierid_t id) {
+
+    struct process_sync *barrier = process_sync_from_id(barrier_pool, id);
+    if (barrier == NULL)
+        return -1;
+
+    if (++barrier->barrier.arrived < barrier->barrier.count)
+        return process_sync_wait(barrier, NULL, -1);
+
+    // Last process to arrive, release all others for the next round.
+    barrier->barrier.arrived = 0;
+    process_sync_preempt(process_sync_resume_all(barrier, 0));
+
+    // Like pthread, a single process gets a special value.
+    return 1;
+
+}
+
+int process_barrier_reset(barrierid_t id) {
+
+    struct process_sync *barrier = process_sync_from_id(barrier_pool, id);
+    if (barrier == NULL)
+        return -1;
+
+    barrier->barrier.arrived = 0;
+    process_sync_preempt(process_sync_resume_all(barrier, -1));
+    return 0;
+
+}
+
+// Internals
+
+void process_sync_set_priority(struct process *process, int new_priority) {
+
+    struct process_sync *sync = process->wait_sync.sync;
+    process->priority = new_priority;
+
+    process_sync_remove_process(sync, process);
+    process_sync_add_process(sync, process);
+
+}
+
+void process_sync_kill_process(struct process *process) {
+
+    struct process_sync *sync = process->wait_sync.sync;
+    process_sync_remove_process(sync, process);
+
+    if (sync->kind == PROCESS_SYNC_BARRIER)
+        sync->barrier.arrived--;
+
+}
+
+void process_mutex_kill_owner(struct process *process) {
+
+    // Mutexes owned by a dead process are released, there are few of
+    // them so we just scan the pool. Processes are only re-scheduled
+    // because we are in the middle of a kill.
+    for (size_t i = 0; i < SYNC_POOL_CAP; i++) {
+        struct process_sync *mutex = mutex_pool[i];
+        if (mutex != NULL && mutex->mutex.owner == process)
+            process_mutex_release(mutex);
+    }
+
+}
@@ -7,10 +7,12 @@
 #include "syscall.h"
 #include "memory.h"
 #include "power.h"
+#include "vdso.h"
 #include "cons.h"
 #include "pit.h"
 #include "cga.h"
 #include "log.h"
+#include "cpu.h"
 
 #include "stddef.h"
 #include "stdio.h"
@@ -18,7 +20,7 @@
 
 /// Function wrapper to check access rights to pointers.
 static void clock_settings(uint32_t *quartz_freq, uint32_t *ticks) {
-    if (process_check_user_ptr(quartz_freq) && process_check_user_ptr(ticks)) {
+    if (process_check_user_range(quartz_freq, sizeof(uint32_t)) && process_check_user_range(ticks, sizeof(uint32_t))) {
         pit_clock_settings(quartz_freq, ticks);
     }
 }
@@ -30,13 +32,13 @@ static uint32_t clock_get() {
 
 /// Function wrapper for cons write to check access rights.
 static void console_write(const char *src, int32_t len) {
-    if (process_check_user_ptr(src)) {
+    if (len >= 0 && process_check_user_range(src, len)) {
         cons_write(src, len);
     }
 }
 
 static int system_memory_info(size_t *capacity, size_t *used) {
-    if (process_check_user_ptr(capacity) && process_check_user_ptr(used)) {
+    if (process_check_user_range(capacity, sizeof(size_t)) && process_check_user_range(used, sizeof(size_t))) {
         *capacity = page_capacity() * PAGE_SIZE;
         *used = page_used() * PAGE_SIZE;
         return 0;
@@ -46,8 +48,140 @@ static int system_memory_info(size_t *capacity, size_t *used) {
 }
 
 
-/// Type alias for a syscall function handler.
-typedef void *syscall_handler_t;
+// Must be a power of two.
+#define SYSCALL_TRACE_CAP 128
+
+/// Number of syscalls, for the bounds check of the assembly dispatch.
+const uint32_t syscall_count = SYSCALL_COUNT;
+
+/// Counters updated by the assembly dispatch after each call, they
+/// are cheap enough to be always enabled.
+uint32_t syscall_stats_count[SYSCALL_COUNT];
+uint64_t syscall_stats_cycles[SYSCALL_COUNT];
+
+/// Number of traced processes, the dispatch only calls the tracing
+/// functions if it is not zero.
+uint32_t syscall_trace_active = 0;
+
+/// Ring of the last syscalls completed by traced processes, the
+/// total number of recorded entries gives the next index.
+static struct syscall_trace_entry syscall_trace_ring[SYSCALL_TRACE_CAP];
+static uint32_t syscall_trace_total = 0;
+
+/// Called by the dispatch before the handler when tracing is active,
+/// arguments are saved now because handlers may overwrite them.
+void syscall_trace_enter(uint32_t num, const uint32_t *args) {
+
+    if (!process_active->syscall_trace)
+        return;
+
+    struct syscall_trace_entry *entry = &process_active->syscall_trace_entry;
+    entry->pid = process_active->pid;
+    entry->num = num;
+    for (size_t i = 0; i < 5; i++)
+        entry->args[i] = args[i];
+
+    process_active->syscall_trace_pending = true;
+
+}
+
+/// Called by the dispatch after the handler when tracing is active,
+/// the pending entry of the process is pushed to the ring.
+void syscall_trace_exit(int ret, uint64_t cycles) {
+
+    if (!process_active->syscall_trace_pending)
+        return;
+
+    struct syscall_trace_entry *entry = &process_active->syscall_trace_entry;
+    entry->ret = ret;
+    entry->cycles = cycles;
+
+    syscall_trace_ring[syscall_trace_total & (SYSCALL_TRACE_CAP - 1)] = *entry;
+    syscall_trace_total++;
+
+    process_active->syscall_trace_pending = false;
+
+}
+
+void syscall_trace_kill_process(struct process *process) {
+    if (process->syscall_trace) {
+        process->syscall_trace = false;
+        process->syscall_trace_pending = false;
+        syscall_trace_active--;
+    }
+}
+
+static int system_syscall_stats(struct syscall_stat *stats, int count) {
+
+    // Counters are kept in two arrays for the assembly dispatch, so
+    // they are gathered here and copied at once.
+    static struct syscall_stat stats_buffer[SYSCALL_COUNT];
+
+    if (count < 0)
+        return -1;
+
+    if (count > SYSCALL_COUNT)
+        count = SYSCALL_COUNT;
+
+    for (int i = 0; i < count; i++) {
+        stats_buffer[i].count = syscall_stats_count[i];
+        stats_buffer[i].cycles = syscall_stats_cycles[i];
+    }
+
+    if (copy_to_user(stats, stats_buffer, count * sizeof(struct syscall_stat)))
+        return -1;
+
+    return SYSCALL_COUNT;
+
+}
+
+/// Enable or disable tracing of a process, the previous state is
+/// returned.
+static int system_syscall_trace(pid_t pid, int enable) {
+
+    struct process *process = process_from_pid(pid);
+    if (process == NULL || process->state == PROCESS_ZOMBIE)
+        return -1;
+
+    bool previous = process->syscall_trace;
+    if (enable && !previous) {
+        process->syscall_trace = true;
+        syscall_trace_active++;
+    } else if (!enable && previous) {
+        process->syscall_trace = false;
+        process->syscall_trace_pending = false;
+        syscall_trace_active--;
+    }
+
+    return previous;
+
+}
+
+/// Copy the last recorded entries, oldest first, the number of copied
+/// entries is returned.
+static int system_syscall_trace_read(struct syscall_trace_entry *entries, int count) {
+
+    if (count < 0)
+        return -1;
+
+    uint32_t available = syscall_trace_total < SYSCALL_TRACE_CAP ? syscall_trace_total : SYSCALL_TRACE_CAP;
+    if ((uint32_t) count > available)
+        count = available;
+
+    // The entries are copied with at most two copies in the ring.
+    uint32_t index = (syscall_trace_total - count) & (SYSCALL_TRACE_CAP - 1);
+    uint32_t first = SYSCALL_TRACE_CAP - index;
+    if (first > (uint32_t) count)
+        first = count;
+
+    if (copy_to_user(entries, syscall_trace_ring + index, first * sizeof(struct syscall_trace_entry)))
+        return -1;
+    if (copy_to_user(entries + first, syscall_trace_ring, (count - first) * sizeof(struct syscall_trace_entry)))
+        return -1;
+
+    return count;
+
+}
 
 /// Define all syscall handlers, used by assembly.
 syscall_handler_t syscall_handlers[SYSCALL_COUNT] = {
@@ -62,29 +196,128 @@ syscall_handler_t syscall_handlers[SYSCALL_COUNT] = {
     [SC_PROCESS_STATE]          = process_state,
     [SC_PROCESS_CHILDREN]       = process_children,
     [SC_PROCESS_WAIT_CLOCK]     = process_wait_clock,
+    [SC_PROCESS_WAIT_ANY]       = process_wait_any,
+    [SC_PROCESS_FUTEX_WAIT]     = process_futex_wait,
+    [SC_PROCESS_FUTEX_WAKE]     = process_futex_wake,
     [SC_PROCESS_QUEUE_CREATE]   = process_queue_create,
     [SC_PROCESS_QUEUE_DELETE]   = process_queue_delete,
     [SC_PROCESS_QUEUE_SEND]     = process_queue_send,
     [SC_PROCESS_QUEUE_RECEIVE]  = process_queue_receive,
     [SC_PROCESS_QUEUE_COUNT]    = process_queue_count,
     [SC_PROCESS_QUEUE_RESET]    = process_queue_reset,
+    [SC_PROCESS_QUEUE_SEND_MANY]    = process_queue_send_many,
+    [SC_PROCESS_QUEUE_RECEIVE_MANY] = process_queue_receive_many,
+    [SC_PROCESS_QUEUE_SEND_TIMED]   = process_queue_send_timed,
+    [SC_PROCESS_QUEUE_RECEIVE_TIMED] = process_queue_receive_timed,
+    [SC_PROCESS_QUEUE_RESIZE]       = process_queue_resize,
+    [SC_PROCESS_QUEUE_CALL]         = process_queue_call,
+    [SC_PROCESS_QUEUE_RECEIVE_CALL] = process_queue_receive_call,
+    [SC_PROCESS_QUEUE_REPLY]        = process_queue_reply,
+    [SC_PROCESS_QUEUE_CREATE_PRIO]  = process_queue_create_prio,
+    [SC_PROCESS_QUEUE_SEND_PRIO]    = process_queue_send_prio,
+    [SC_PROCESS_TOPIC_CREATE]       = process_topic_create,
+    [SC_PROCESS_TOPIC_DELETE]       = process_topic_delete,
+    [SC_PROCESS_TOPIC_SUBSCRIBE]    = process_topic_subscribe,
+    [SC_PROCESS_TOPIC_UNSUBSCRIBE]  = process_topic_unsubscribe,
+    [SC_PROCESS_TOPIC_PUBLISH]      = process_topic_publish,
+    [SC_PROCESS_TOPIC_DROPS]        = process_topic_drops,
+    [SC_PROCESS_DGRAM_CREATE]   = process_dgram_create,
+    [SC_PROCESS_DGRAM_DELETE]   = process_dgram_delete,
+    [SC_PROCESS_DGRAM_SEND]     = process_dgram_send,
+    [SC_PROCESS_DGRAM_RECEIVE]  = process_dgram_receive,
+    [SC_PROCESS_DGRAM_COUNT]    = process_dgram_count,
+    [SC_PROCESS_DGRAM_RESET]    = process_dgram_reset,
+    [SC_PROCESS_SEM_CREATE]     = process_sem_create,
+    [SC_PROCESS_SEM_DELETE]     = process_sem_delete,
+    [SC_PROCESS_SEM_WAIT]       = process_sem_wait,
+    [SC_PROCESS_SEM_TRY_WAIT]   = process_sem_try_wait,
+    [SC_PROCESS_SEM_SIGNAL]     = process_sem_signal,
+    [SC_PROCESS_SEM_COUNT]      = process_sem_count,
+    [SC_PROCESS_SEM_RESET]      = process_sem_reset,
+    [SC_PROCESS_MUTEX_CREATE]   = process_mutex_create,
+    [SC_PROCESS_MUTEX_DELETE]   = process_mutex_delete,
+    [SC_PROCESS_MUTEX_LOCK]     = process_mutex_lock,
+    [SC_PROCESS_MUTEX_TRY_LOCK] = process_mutex_try_lock,
+    [SC_PROCESS_MUTEX_UNLOCK]   = process_mutex_unlock,
+    [SC_PROCESS_COND_CREATE]    = process_cond_create,
+    [SC_PROCESS_COND_DELETE]    = process_cond_delete,
+    [SC_PROCESS_COND_WAIT]      = process_cond_wait,
+    [SC_PROCESS_COND_SIGNAL]    = process_cond_signal,
+    [SC_PROCESS_COND_BROADCAST] = process_cond_broadcast,
+    [SC_PROCESS_BARRIER_CREATE] = process_barrier_create,
+    [SC_PROCESS_BARRIER_DELETE] = process_barrier_delete,
+    [SC_PROCESS_BARRIER_WAIT]   = process_barrier_wait,
+    [SC_PROCESS_BARRIER_RESET]  = process_barrier_reset,
+    [SC_PROCESS_SHM_CREATE]     = process_shm_create,
+    [SC_PROCESS_SHM_ATTACH]     = process_shm_attach,
+    [SC_PROCESS_SHM_DETACH]     = process_shm_detach,
+    [SC_PROCESS_SHM_DESTROY]    = process_shm_destroy,
+    [SC_PROCESS_RING_SETUP]     = process_ring_setup,
+    [SC_PROCESS_RING_SUBMIT]    = process_ring_submit,
     [SC_CLOCK_SETTINGS]         = clock_settings,
     [SC_CLOCK_GET]              = clock_get,
     [SC_CONSOLE_WRITE]          = console_write,
     [SC_CONSOLE_READ]           = process_wait_cons_read,
     [SC_CONSOLE_ECHO]           = cons_echo,
     [SC_SYSTEM_MEMORY_INFO]     = system_memory_info,
+    [SC_SYSTEM_MEMORY_TRACE]    = mem_trace_sites,
+    [SC_SYSTEM_SYSCALL_STATS]   = system_syscall_stats,
+    [SC_SYSTEM_SYSCALL_TRACE]   = system_syscall_trace,
+    [SC_SYSTEM_SYSCALL_TRACE_READ] = system_syscall_trace_read,
+    [SC_SYSTEM_VDSO]            = vdso_user_data,
     [SC_SYSTEM_POWER_OFF]       = power_off,
 };
 
 struct syscall_context *syscall_context = NULL;
 
 
+#define MSR_SYSENTER_CS  0x174
+#define MSR_SYSENTER_ESP 0x175
+#define MSR_SYSENTER_EIP 0x176
+
 /// Syscall interrupt handler defined in assembly.
 void syscall_handler(void);
+/// Syscall SYSENTER handler defined in assembly.
+void syscall_fast_handler(void);
+
+/// Stack loaded by SYSENTER, the handler immediately switches to the
+/// kernel stack of the active process, so it is never used.
+static uint32_t syscall_fast_stack[4];
+
+/// Return true if the processor supports SYSENTER/SYSEXIT. Early
+/// Pentium Pro report the feature without supporting it.
+static bool syscall_fast_supported(void) {
+
+    unsigned long eax, ebx, ecx, edx;
+    cpuid(0, &eax, &ebx, &ecx, &edx);
+    if (eax < 1)
+        return false;
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    unsigned long family = (eax >> 8) & 0xF;
+    unsigned long model = (eax >> 4) & 0xF;
+    unsigned long stepping = eax & 0xF;
+
+    if (family == 6 && model < 3 && stepping < 3)
+        return false;
+
+    return (edx & (1 << 11)) != 0;
+
+}
 
 void syscall_init(void) {
+
     printf(LOG_EMPTY "System calls init...\r");
     idt_interrupt_gate(SYSCALL_INTERRUPT, (uint32_t) syscall_handler, 3);
-    printf(LOG_OK "System calls ready: %d syscalls\n", SYSCALL_COUNT);
+
+    // The user stub makes the same check before using SYSENTER.
+    bool fast = syscall_fast_supported();
+    if (fast) {
+        wrmsr(MSR_SYSENTER_CS, KERNEL_CS);
+        wrmsr(MSR_SYSENTER_ESP, (uint32_t) (syscall_fast_stack + 4));
+        wrmsr(MSR_SYSENTER_EIP, (uint32_t) syscall_fast_handler);
+    }
+
+    printf(LOG_OK "System calls ready: %d syscalls%s\n", SYSCALL_COUNT, fast ? ", sysenter" : "");
+
 }
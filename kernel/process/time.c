@@ -7,11 +7,11 @@ static struct process *clock_wait_head = NULL;
 
 void process_time_queue_add(struct process *process) {
 
-    if (process->state != PROCESS_WAIT_TIME) {
-        panic("process_time_queue_add(...): process->state is not WAIT_TIME\n");
+    if (process->state != PROCESS_WAIT_TIME && process->state != PROCESS_WAIT_QUEUE && process->state != PROCESS_WAIT_ANY && process->state != PROCESS_WAIT_FUTEX) {
+        panic("process_time_queue_add(...): process->state doesn't support timeout\n");
     }
 
-    uint32_t target_clock = process->wait_time.target_clock;
+    uint32_t target_clock = process->timeout.target_clock;
 
     // Here we insert the process in the right order. Our linked list
     // is ordered by target clock time. No need to order by priority
@@ -20,33 +20,37 @@ void process_time_queue_add(struct process *process) {
 
     struct process **process_ptr = &clock_wait_head;
     while (*process_ptr != NULL) {
-        if (target_clock <= (*process_ptr)->wait_time.target_clock) {
-            // Our process has lower or equal target clock, we insert
-            // it in place.
+        if (target_clock < (*process_ptr)->timeout.target_clock) {
+            // Our process has lower target clock, we insert it in 
+            // place, after processes with equal target clock.
             break;
         }
+        process_ptr = &(*process_ptr)->timeout.next;
     }
 
     // Insert process at the given pointer.
-    process->wait_time.next = *process_ptr;
+    process->timeout.next = *process_ptr;
+    process->timeout.queued = true;
     *process_ptr = process;
 
 }
 
 void process_time_queue_remove(struct process *process) {
-    
-    if (process->state != PROCESS_WAIT_TIME) {
-        panic("process_time_queue_remove(...): process->state is not WAIT_TIME\n");
-    }
+
+    if (!process->timeout.queued)
+        return;
 
     struct process **process_ptr = &clock_wait_head;
     while (*process_ptr != NULL) {
         if (*process_ptr == process) {
-            *process_ptr = process->wait_time.next;
+            *process_ptr = process->timeout.next;
             break;
         }
+        process_ptr = &(*process_ptr)->timeout.next;
     }
 
+    process->timeout.queued = false;
+
 }
 
 void process_time_pit_handler(uint32_t clock) {
@@ -56,24 +60,30 @@ void process_time_pit_handler(uint32_t clock) {
     struct process *highest_process = NULL;
 
     struct process *process = clock_wait_head;
-    while (process != NULL && process->wait_time.target_clock <= clock) {
-
-#if PROCESS_DEBUG
-        if (process->state != PROCESS_WAIT_TIME) {
-            panic("[%s] process_time_pit_handler(...): process %s reached target clock but is in state %d\n", process_active->name, process->name, process->state);
-        }
-#endif
+    while (process != NULL && process->timeout.target_clock <= clock) {
 
         // Find the highest priority between all woken up process.
         if (highest_process == NULL || highest_process->priority < process->priority) {
             highest_process = process;
         }
 
-        struct process *next_process = process->wait_time.next;
-
-        // Re-schedule the process that reached target clock.
-        process->state = PROCESS_SCHED;
-        process_sched_ring_insert(process);
+        struct process *next_process = process->timeout.next;
+        process->timeout.queued = false;
+
+        // Re-schedule the process that reached target clock, timed
+        // waits must also be removed from what they are waiting for.
+        if (process->state == PROCESS_WAIT_TIME) {
+            process->state = PROCESS_SCHED;
+            process_sched_ring_insert(process);
+        } else if (process->state == PROCESS_WAIT_QUEUE) {
+            process_queue_timeout_process(process);
+        } else if (process->state == PROCESS_WAIT_ANY) {
+            process_wait_any_timeout_process(process);
+        } else if (process->state == PROCESS_WAIT_FUTEX) {
+            process_futex_timeout_process(process);
+        } else {
+            panic("[%s] process_time_pit_handler(...): process %s reached target clock but is in state %d\n", process_active->name, process->name, process->state);
+        }
 
         process = next_process;
         
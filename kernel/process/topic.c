@@ -0,0 +1,220 @@
+/// Publish/subscribe broadcast topics, each subscriber receives the
+/// published messages in a private process queue.
+
+#include "internals.h"
+
+#include "process.h"
+#include "memory.h"
+#include "handle.h"
+
+#include "stdio.h"
+#include "string.h"
+
+
+/// Maximum number of live topics, see 'PROCESS_MAX'.
+#define TOPIC_MAX 1024
+
+static struct handle_table topic_table = HANDLE_TABLE_INIT(TOPIC_MAX);
+
+
+/// Get a topic pointer from its ID, null if the ID is invalid. A
+/// stale ID of a deleted topic never resolves to a new one.
+static struct process_topic *process_topic_from_tid(tid_t tid) {
+    return handle_get(&topic_table, tid);
+}
+
+/// Find the index of a subscriber from its queue ID, -1 if not found.
+static int process_topic_find(struct process_topic *topic, qid_t qid) {
+    for (size_t i = 0; i < topic->sub_count; i++) {
+        if (topic->subs[i].qid == qid)
+            return i;
+    }
+    return -1;
+}
+
+/// Remove the subscriber at the given index, its queue is not deleted.
+static void process_topic_remove(struct process_topic *topic, size_t index) {
+    topic->subs[index] = topic->subs[--topic->sub_count];
+}
+
+tid_t process_topic_create(int capacity, int policy) {
+
+    if (capacity <= 0 || handle_table_full(&topic_table))
+        return -1;
+
+    if (policy != TOPIC_OVERFLOW_BLOCK && policy != TOPIC_OVERFLOW_DROP_OLDEST && policy != TOPIC_OVERFLOW_DROP_NEWEST)
+        return -1;
+
+    struct process_topic *topic = kalloc(sizeof(struct process_topic));
+    if (topic == NULL)
+        return -1;
+
+    topic->capacity = capacity;
+    topic->policy = policy;
+    topic->seq = 0;
+    topic->subs = NULL;
+    topic->sub_count = 0;
+    topic->sub_capacity = 0;
+    topic->drops = 0;
+
+    topic->tid = handle_alloc(&topic_table, topic);
+    if (topic->tid < 0) {
+        kfree(topic);
+        return -1;
+    }
+
+    return topic->tid;
+
+}
+
+int process_topic_delete(tid_t tid) {
+
+    struct process_topic *topic = process_topic_from_tid(tid);
+    if (topic == NULL)
+        return -1;
+
+    handle_free(&topic_table, topic->tid);
+
+    // The topic is unreachable now, so deleting queues may preempt us.
+    // Queues already deleted by their subscriber are just ignored.
+    for (size_t i = 0; i < topic->sub_count; i++)
+        process_queue_delete(topic->subs[i].qid);
+
+    kfree(topic->subs);
+    kfree(topic);
+
+    return 0;
+
+}
+
+qid_t process_topic_subscribe(tid_t tid) {
+
+    struct process_topic *topic = process_topic_from_tid(tid);
+    if (topic == NULL)
+        return -1;
+
+    if (topic->sub_count == topic->sub_capacity) {
+
+        size_t new_capacity = topic->sub_capacity == 0 ? 4 : topic->sub_capacity * 2;
+        struct process_topic_sub *subs = kalloc(sizeof(struct process_topic_sub) * new_capacity);
+        if (subs == NULL)
+            return -1;
+
+        if (topic->subs != NULL) {
+            memcpy(subs, topic->subs, sizeof(struct process_topic_sub) * topic->sub_count);
+            kfree(topic->subs);
+        }
+
+        topic->subs = subs;
+        topic->sub_capacity = new_capacity;
+
+    }
+
+    qid_t qid = process_queue_create(topic->capacity);
+    if (qid < 0)
+        return -1;
+
+    // New subscribers don't receive a publication in progress.
+    struct process_topic_sub *sub = &topic->subs[topic->sub_count++];
+    sub->qid = qid;
+    sub->seq = topic->seq;
+    sub->drops = 0;
+
+    return qid;
+
+}
+
+int process_topic_unsubscribe(tid_t tid, qid_t qid) {
+
+    struct process_topic *topic = process_topic_from_tid(tid);
+    if (topic == NULL)
+        return -1;
+
+    int index = process_topic_find(topic, qid);
+    if (index < 0)
+        return -1;
+
+    process_topic_remove(topic, index);
+    process_queue_delete(qid);
+
+    return 0;
+
+}
+
+int process_topic_publish(tid_t tid, int message) {
+
+    struct process_topic *topic = process_topic_from_tid(tid);
+    if (topic == NULL)
+        return -1;
+
+    uint32_t seq = ++topic->seq;
+    struct process *wake_process = NULL;
+
+    size_t i = 0;
+    while (i < topic->sub_count) {
+
+        struct process_topic_sub *sub = &topic->subs[i];
+        if (sub->seq == seq) {
+            i++;
+            continue;
+        }
+
+        struct process_queue *queue = process_queue_from_qid(sub->qid);
+        if (queue == NULL) {
+            // The subscriber deleted its queue.
+            process_topic_remove(topic, i);
+            continue;
+        }
+
+        sub->seq = seq;
+
+        int ret = process_queue_offer(queue, message, topic->policy == TOPIC_OVERFLOW_DROP_OLDEST, &wake_process);
+        if (ret == 0) {
+            i++;
+            continue;
+        } else if (ret > 0 || topic->policy == TOPIC_OVERFLOW_DROP_NEWEST) {
+            sub->drops++;
+            topic->drops++;
+            i++;
+            continue;
+        }
+
+        // Block like a normal send, processes already woken up may run
+        // before us. The topic may have changed while we were blocked,
+        // so we look it up again and scan subscribers from the start,
+        // those already delivered have the current sequence number.
+        process_queue_send(sub->qid, message);
+        wake_process = NULL;
+
+        topic = process_topic_from_tid(tid);
+        if (topic == NULL)
+            return -1;
+
+        i = 0;
+
+    }
+
+    if (wake_process != NULL && wake_process->priority > process_active->priority) {
+        process_sched_advance(wake_process);
+    }
+
+    return 0;
+
+}
+
+int process_topic_drops(tid_t tid, qid_t qid) {
+
+    struct process_topic *topic = process_topic_from_tid(tid);
+    if (topic == NULL)
+        return -1;
+
+    if (qid < 0)
+        return topic->drops;
+
+    int index = process_topic_find(topic, qid);
+    if (index < 0)
+        return -1;
+
+    return topic->subs[index].drops;
+
+}
@@ -0,0 +1,69 @@
+/// Page of kernel data mapped read-only in user space.
+
+#include "vdso.h"
+#include "memory.h"
+#include "pit.h"
+#include "log.h"
+
+#include "stdio.h"
+
+
+/// The data owns a whole page, so that nothing else in the kernel is
+/// visible through the mapping.
+static union {
+    struct vdso_data data;
+    uint8_t page[PAGE_SIZE];
+} vdso_page __attribute__((aligned(PAGE_SIZE)));
+
+static const struct vdso_data *vdso_user = NULL;
+
+
+/// Start an update, readers retry while the sequence is odd.
+static inline void vdso_write_begin(void) {
+    vdso_page.data.seq++;
+    __asm__ __volatile__("" ::: "memory");
+}
+
+static inline void vdso_write_end(void) {
+    __asm__ __volatile__("" ::: "memory");
+    vdso_page.data.seq++;
+}
+
+void vdso_init(void) {
+
+    printf(LOG_EMPTY "vDSO init...\r");
+
+    uint32_t quartz, interval;
+    pit_clock_settings(&quartz, &interval);
+
+    vdso_write_begin();
+    vdso_page.data.clock = pit_clock_get();
+    vdso_page.data.quartz = quartz;
+    vdso_page.data.interval = interval;
+    vdso_page.data.pid = -1;
+    vdso_write_end();
+
+    vdso_user = page_map_user_read_only(&vdso_page, PAGE_SIZE);
+    if (vdso_user == NULL) {
+        printf(LOG_FAIL "vDSO mapping failed\n");
+    } else {
+        printf(LOG_OK "vDSO ready: 0x%08x\n", (uint32_t) vdso_user);
+    }
+
+}
+
+void vdso_set_clock(uint32_t clock) {
+    vdso_write_begin();
+    vdso_page.data.clock = clock;
+    vdso_write_end();
+}
+
+void vdso_set_pid(int pid) {
+    vdso_write_begin();
+    vdso_page.data.pid = pid;
+    vdso_write_end();
+}
+
+const struct vdso_data *vdso_user_data(void) {
+    return vdso_user;
+}
@@ -0,0 +1,166 @@
+/// Generic wait objects, allowing a process to wait for any of many
+/// sources (queues, children, clock, console) at once. Objects that
+/// can become ready embed a wait object and notify it, waiting
+/// processes are woken up and check again all their sources.
+
+#include "internals.h"
+
+#include "process.h"
+#include "pit.h"
+
+#include "stdio.h"
+
+
+/// Remove all watches of a process waiting for any source, including
+/// its deadline.
+static void process_wait_any_unwatch(struct process *process) {
+
+    for (size_t i = 0; i < process->wait_any.count; i++) {
+        struct process_watch *watch = &process->wait_any.watches[i];
+        if (watch->node.next != NULL)
+            queue_del(watch, node);
+    }
+
+    process_time_queue_remove(process);
+
+}
+
+/// Remove all watches of a process waiting for any source and
+/// re-schedule it.
+static void process_wait_any_wake(struct process *process) {
+
+    process_wait_any_unwatch(process);
+
+    process->state = PROCESS_SCHED;
+    process_sched_ring_insert(process);
+
+}
+
+/// Register a watch for the active process, which must be in the
+/// `PROCESS_WAIT_ANY` state.
+static void process_wait_any_watch(struct process_wait_object *object) {
+    struct process_watch *watch = &process_active->wait_any.watches[process_active->wait_any.count++];
+    watch->process = process_active;
+    watch->priority = process_active->priority;
+    INIT_LINK(&watch->node);
+    queue_add(watch, &object->watchers, struct process_watch, node, priority);
+}
+
+/// Check if a source is ready, returning 1 if ready, 0 if not and -1
+/// if the source is invalid. If not ready, the object to watch is
+/// returned, or null for clock sources.
+static int process_wait_source_check(const struct wait_source *source, struct process_wait_object **object) {
+
+    *object = NULL;
+
+    switch (source->kind) {
+        case WAIT_SOURCE_QUEUE_RECEIVE:
+            return process_queue_watch(source->id, false, object);
+        case WAIT_SOURCE_QUEUE_SEND:
+            return process_queue_watch(source->id, true, object);
+        case WAIT_SOURCE_CHILD:
+            return process_child_watch(source->id, object);
+        case WAIT_SOURCE_CLOCK:
+            return (uint32_t) source->id <= pit_clock_get();
+        case WAIT_SOURCE_CONS_READ:
+            return process_cons_read_watch(object);
+        default:
+            return -1;
+    }
+
+}
+
+void process_wait_object_init(struct process_wait_object *object) {
+    INIT_LIST_HEAD(&object->watchers);
+}
+
+struct process *process_wait_object_notify(struct process_wait_object *object) {
+
+    struct process *highest_process = NULL;
+
+    // Waking a process removes all of its watches, including the one
+    // we are popping.
+    struct process_watch *watch;
+    while ((watch = queue_out(&object->watchers, struct process_watch, node)) != NULL) {
+
+        struct process *process = watch->process;
+        process_wait_any_wake(process);
+
+        if (highest_process == NULL || highest_process->priority < process->priority) {
+            highest_process = process;
+        }
+
+    }
+
+    return highest_process;
+
+}
+
+void process_wait_object_signal(struct process_wait_object *object) {
+
+    if (queue_empty(&object->watchers))
+        return;
+
+    struct process *highest_process = process_wait_object_notify(object);
+    if (highest_process != NULL && highest_process->priority > process_active->priority) {
+        process_sched_advance(highest_process);
+    }
+
+}
+
+int process_wait_any(const struct wait_source *sources, int count) {
+
+    if (count <= 0 || count > PROCESS_WAIT_ANY_CAP || !process_check_user_array(sources, count, sizeof(struct wait_source)))
+        return -1;
+
+    struct process_wait_object *object;
+
+    while (1) {
+
+        // Level-triggered: sources are checked again after each
+        // wakeup, the first ready one is returned.
+        for (int i = 0; i < count; i++) {
+            int ready = process_wait_source_check(&sources[i], &object);
+            if (ready != 0)
+                return ready < 0 ? -1 : i;
+        }
+
+        struct process *next_process = process_sched_ring_remove(process_active);
+        process_active->state = PROCESS_WAIT_ANY;
+        process_active->wait_any.count = 0;
+
+        // Nothing can change between the two checks, so no source is
+        // ready here and the nearest clock becomes our deadline.
+        bool has_deadline = false;
+        uint32_t deadline = 0;
+
+        for (int i = 0; i < count; i++) {
+            process_wait_source_check(&sources[i], &object);
+            if (object != NULL) {
+                process_wait_any_watch(object);
+            } else if (sources[i].kind == WAIT_SOURCE_CLOCK) {
+                if (!has_deadline || (uint32_t) sources[i].id < deadline) {
+                    deadline = sources[i].id;
+                    has_deadline = true;
+                }
+            }
+        }
+
+        if (has_deadline) {
+            process_active->timeout.target_clock = deadline;
+            process_time_queue_add(process_active);
+        }
+
+        process_sched_advance(next_process);
+
+    }
+
+}
+
+void process_wait_any_kill_process(struct process *process) {
+    process_wait_any_unwatch(process);
+}
+
+void process_wait_any_timeout_process(struct process *process) {
+    process_wait_any_wake(process);
+}
@@ -3,6 +3,7 @@
 #include "keyboard.h"
 #include "segment.h"
 #include "syscall.h"
+#include "vdso.h"
 #include "process.h"
 #include "memory.h"
 #include "start.h"
@@ -20,6 +21,7 @@ void kernel_start(void) {
 	printf("\f");
 	page_init();
 	pit_init();
+	vdso_init();
 	ps2_init();
 	keyboard_init();
 	syscall_init();
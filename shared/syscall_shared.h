@@ -14,6 +14,14 @@
 // Interrupt number used for syscalls.
 #define SYSCALL_INTERRUPT   49
 
+// Returned by non-blocking or timed syscalls when the operation would
+// block, or when the deadline has been reached.
+#define SYSCALL_WOULD_BLOCK (-2)
+
+// Result of a linked ring entry that was not executed because the
+// previous entry of its chain failed, see 'SC_PROCESS_RING_SUBMIT'.
+#define SYSCALL_CANCELED    (-3)
+
 enum syscall_num {
     // Process control
     SC_PROCESS_START,
@@ -27,6 +35,9 @@ enum syscall_num {
     SC_PROCESS_CHILDREN,
     SC_PROCESS_STATE,
     SC_PROCESS_WAIT_CLOCK,
+    SC_PROCESS_WAIT_ANY,
+    SC_PROCESS_FUTEX_WAIT,
+    SC_PROCESS_FUTEX_WAKE,
     // Process queue control
     SC_PROCESS_QUEUE_CREATE,
     SC_PROCESS_QUEUE_DELETE,
@@ -34,6 +45,60 @@ enum syscall_num {
     SC_PROCESS_QUEUE_RECEIVE,
     SC_PROCESS_QUEUE_COUNT,
     SC_PROCESS_QUEUE_RESET,
+    SC_PROCESS_QUEUE_SEND_MANY,
+    SC_PROCESS_QUEUE_RECEIVE_MANY,
+    SC_PROCESS_QUEUE_SEND_TIMED,
+    SC_PROCESS_QUEUE_RECEIVE_TIMED,
+    SC_PROCESS_QUEUE_RESIZE,
+    SC_PROCESS_QUEUE_CALL,
+    SC_PROCESS_QUEUE_RECEIVE_CALL,
+    SC_PROCESS_QUEUE_REPLY,
+    SC_PROCESS_QUEUE_CREATE_PRIO,
+    SC_PROCESS_QUEUE_SEND_PRIO,
+    // Process broadcast topic control
+    SC_PROCESS_TOPIC_CREATE,
+    SC_PROCESS_TOPIC_DELETE,
+    SC_PROCESS_TOPIC_SUBSCRIBE,
+    SC_PROCESS_TOPIC_UNSUBSCRIBE,
+    SC_PROCESS_TOPIC_PUBLISH,
+    SC_PROCESS_TOPIC_DROPS,
+    // Process datagram queue control
+    SC_PROCESS_DGRAM_CREATE,
+    SC_PROCESS_DGRAM_DELETE,
+    SC_PROCESS_DGRAM_SEND,
+    SC_PROCESS_DGRAM_RECEIVE,
+    SC_PROCESS_DGRAM_COUNT,
+    SC_PROCESS_DGRAM_RESET,
+    // Process synchronization objects control
+    SC_PROCESS_SEM_CREATE,
+    SC_PROCESS_SEM_DELETE,
+    SC_PROCESS_SEM_WAIT,
+    SC_PROCESS_SEM_TRY_WAIT,
+    SC_PROCESS_SEM_SIGNAL,
+    SC_PROCESS_SEM_COUNT,
+    SC_PROCESS_SEM_RESET,
+    SC_PROCESS_MUTEX_CREATE,
+    SC_PROCESS_MUTEX_DELETE,
+    SC_PROCESS_MUTEX_LOCK,
+    SC_PROCESS_MUTEX_TRY_LOCK,
+    SC_PROCESS_MUTEX_UNLOCK,
+    SC_PROCESS_COND_CREATE,
+    SC_PROCESS_COND_DELETE,
+    SC_PROCESS_COND_WAIT,
+    SC_PROCESS_COND_SIGNAL,
+    SC_PROCESS_COND_BROADCAST,
+    SC_PROCESS_BARRIER_CREATE,
+    SC_PROCESS_BARRIER_DELETE,
+    SC_PROCESS_BARRIER_WAIT,
+    SC_PROCESS_BARRIER_RESET,
+    // Process shared memory control
+    SC_PROCESS_SHM_CREATE,
+    SC_PROCESS_SHM_ATTACH,
+    SC_PROCESS_SHM_DETACH,
+    SC_PROCESS_SHM_DESTROY,
+    // Process syscall ring control
+    SC_PROCESS_RING_SETUP,
+    SC_PROCESS_RING_SUBMIT,
     // Clock settings
     SC_CLOCK_SETTINGS,
     SC_CLOCK_GET,
@@ -43,9 +108,141 @@ enum syscall_num {
     SC_CONSOLE_ECHO,
     // System management
     SC_SYSTEM_MEMORY_INFO,
+    SC_SYSTEM_MEMORY_TRACE,
+    SC_SYSTEM_SYSCALL_STATS,
+    SC_SYSTEM_SYSCALL_TRACE,
+    SC_SYSTEM_SYSCALL_TRACE_READ,
+    SC_SYSTEM_VDSO,
     SC_SYSTEM_POWER_OFF,
     // Max number of syscalls
     SYSCALL_COUNT
 };
 
+/// Policies of broadcast topics when a subscriber's queue is full, see
+/// 'SC_PROCESS_TOPIC_CREATE'.
+enum topic_overflow {
+    /// The publisher blocks until the subscriber receives.
+    TOPIC_OVERFLOW_BLOCK,
+    /// The oldest message of the subscriber's queue is dropped.
+    TOPIC_OVERFLOW_DROP_OLDEST,
+    /// The published message is dropped for this subscriber.
+    TOPIC_OVERFLOW_DROP_NEWEST,
+};
+
+/// Kinds of sources for 'SC_PROCESS_WAIT_ANY'.
+enum wait_source_kind {
+    /// Ready when the queue of given ID has messages to receive.
+    WAIT_SOURCE_QUEUE_RECEIVE,
+    /// Ready when the queue of given ID has space to send.
+    WAIT_SOURCE_QUEUE_SEND,
+    /// Ready when the child of given PID (any child if negative) is
+    /// a zombie, so it can be waited without blocking.
+    WAIT_SOURCE_CHILD,
+    /// Ready when the clock reaches the given ID.
+    WAIT_SOURCE_CLOCK,
+    /// Ready when a line can be read from the console, ID is ignored.
+    WAIT_SOURCE_CONS_READ,
+};
+
+/// A source for 'SC_PROCESS_WAIT_ANY', which returns the index of the
+/// first ready one, at most 16 sources can be given.
+struct wait_source {
+    /// Kind of source, see 'wait_source_kind'.
+    int kind;
+    /// Queue ID, PID or clock depending on the kind.
+    int id;
+};
+
+/// Live kernel allocations of a call site, see 'SC_SYSTEM_MEMORY_TRACE'.
+struct mem_trace_site {
+    /// Return address of the caller of 'kalloc', zero if this entry
+    /// sums all sites that couldn't be reported individually.
+    unsigned int site;
+    /// Number of live allocations.
+    unsigned int count;
+    /// Total size of live allocations.
+    unsigned int bytes;
+};
+
+/// Flag of a submission entry: the next entry is only executed if
+/// this one succeeds (returns a non-negative value).
+#define SYSCALL_RING_LINK 1
+
+/// An operation queued in a submission ring.
+struct syscall_ring_sqe {
+    /// Syscall number, see 'syscall_num'.
+    unsigned int num;
+    /// Raw arguments, as they would be passed in registers.
+    unsigned int args[5];
+    /// Entry flags, see 'SYSCALL_RING_LINK'.
+    unsigned int flags;
+    /// Opaque value copied to the completion entry.
+    unsigned int user_data;
+};
+
+/// Result of an operation, posted to a completion ring.
+struct syscall_ring_cqe {
+    /// Value of the submission entry.
+    unsigned int user_data;
+    /// Returned value of the syscall, or 'SYSCALL_CANCELED'.
+    int ret;
+};
+
+/// Submission and completion rings registered by a process with
+/// 'SC_PROCESS_RING_SETUP'. Heads and tails are free-running indices,
+/// the user produces at 'sq_tail' and consumes at 'cq_head', the
+/// kernel consumes at 'sq_head' and produces at 'cq_tail'.
+struct syscall_ring {
+    /// Number of entries of both rings, a power of two.
+    unsigned int size;
+    /// Submission entries.
+    struct syscall_ring_sqe *sq;
+    /// Completion entries.
+    struct syscall_ring_cqe *cq;
+    unsigned int sq_head;
+    unsigned int sq_tail;
+    unsigned int cq_head;
+    unsigned int cq_tail;
+};
+
+/// Number of calls and total time spent in a syscall since startup,
+/// see 'SC_SYSTEM_SYSCALL_STATS'.
+struct syscall_stat {
+    /// Number of completed calls.
+    unsigned int count;
+    /// Total time of completed calls, in TSC cycles, including the
+    /// time spent blocked.
+    unsigned long long cycles;
+};
+
+/// A completed syscall of a traced process, see
+/// 'SC_SYSTEM_SYSCALL_TRACE_READ'.
+struct syscall_trace_entry {
+    /// PID of the calling process.
+    int pid;
+    /// Syscall number, see 'syscall_num'.
+    unsigned int num;
+    /// Raw arguments, as passed in registers.
+    unsigned int args[5];
+    /// Returned value.
+    int ret;
+    /// Duration of the call, in TSC cycles.
+    unsigned long long cycles;
+};
+
+/// Kernel data mapped read-only in user space, see 'SC_SYSTEM_VDSO'.
+/// The kernel increments the sequence before and after each update,
+/// so readers retry while it's odd or if it changed while reading.
+struct vdso_data {
+    unsigned int seq;
+    /// Clock ticks since startup.
+    unsigned int clock;
+    /// Frequency of the PIT quartz.
+    unsigned int quartz;
+    /// Number of quartz oscillations between two ticks.
+    unsigned int interval;
+    /// PID of the running process.
+    int pid;
+};
+
 #endif
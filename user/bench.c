@@ -0,0 +1,278 @@
+#include "bench.h"
+#include "ensimag.h"
+#include "sync.h"
+#include "syscall.h"
+
+#include "stdio.h"
+
+
+/// Iterations are a power of two, so that cycles per operation are
+/// computed without 64-bit division.
+#define BENCH_ITERATIONS_SHIFT 12
+#define BENCH_ITERATIONS (1 << BENCH_ITERATIONS_SHIFT)
+#define BENCH_BARRIER_PROCESSES 4
+#define BENCH_STACK_SIZE 4096
+
+
+/// Objects shared between the benchmark and its child processes.
+static struct {
+    int first;
+    int second;
+    struct mutex mutex;
+} bench_objects;
+
+static unsigned long long bench_clock(void) {
+    return __builtin_ia32_rdtsc();
+}
+
+static void bench_print(const char *name, unsigned long long start) {
+    unsigned long long cycles = bench_clock() - start;
+    printf("  %-28s %8lu cycles/op\n", name, (unsigned long) (cycles >> BENCH_ITERATIONS_SHIFT));
+}
+
+static int bench_start(process_func_t func, const char *name) {
+    return start(func, BENCH_STACK_SIZE, getprio(getpid()), name, NULL);
+}
+
+// System call entry
+
+static void bench_getpid(void) {
+
+    int fast = syscall_fast;
+
+    if (fast) {
+        unsigned long long start = bench_clock();
+        for (int i = 0; i < BENCH_ITERATIONS; i++)
+            syscall0(SC_PROCESS_PID);
+        bench_print("getpid (sysenter)", start);
+    }
+
+    // Force the interrupt path for comparison.
+    syscall_fast = 0;
+    unsigned long long start = bench_clock();
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+        syscall0(SC_PROCESS_PID);
+    bench_print("getpid (int $49)", start);
+    syscall_fast = fast;
+
+    start = bench_clock();
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+        getpid();
+    bench_print("getpid (vdso)", start);
+
+}
+
+#define BENCH_RING_SIZE 64
+
+static struct syscall_ring_sqe bench_ring_sq[BENCH_RING_SIZE];
+static struct syscall_ring_cqe bench_ring_cq[BENCH_RING_SIZE];
+
+static void bench_ring(void) {
+
+    struct syscall_ring ring = {
+        .size = BENCH_RING_SIZE,
+        .sq = bench_ring_sq,
+        .cq = bench_ring_cq,
+    };
+
+    if (ring_setup(&ring) < 0)
+        return;
+
+    // Same operation as above, batched by the size of the ring.
+    unsigned long long start = bench_clock();
+    for (int i = 0; i < BENCH_ITERATIONS; i += BENCH_RING_SIZE) {
+        for (int j = 0; j < BENCH_RING_SIZE; j++)
+            ring_queue(&ring, SC_PROCESS_PID, NULL, 0, j);
+        ring_submit(BENCH_RING_SIZE);
+        ring.cq_head = ring.cq_tail;
+    }
+    bench_print("getpid (ring batch)", start);
+
+    ring_setup(NULL);
+
+}
+
+// Ping-pong between two processes
+
+static int bench_sem_pong(void *arg) {
+    (void) arg;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        wait(bench_objects.first);
+        signal(bench_objects.second);
+    }
+    return 0;
+}
+
+static int bench_queue_pong(void *arg) {
+    (void) arg;
+    int message;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        preceive(bench_objects.first, &message);
+        psend(bench_objects.second, message);
+    }
+    return 0;
+}
+
+static void bench_ping_pong(void) {
+
+    bench_objects.first = screate(0);
+    bench_objects.second = screate(0);
+    int pid = bench_start(bench_sem_pong, "bench_sem_pong");
+
+    unsigned long long start = bench_clock();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        signal(bench_objects.first);
+        wait(bench_objects.second);
+    }
+    bench_print("semaphore ping-pong", start);
+
+    waitpid(pid, NULL);
+    sdelete(bench_objects.first);
+    sdelete(bench_objects.second);
+
+    bench_objects.first = pcreate(1);
+    bench_objects.second = pcreate(1);
+    pid = bench_start(bench_queue_pong, "bench_queue_pong");
+
+    int message;
+    start = bench_clock();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        psend(bench_objects.first, i);
+        preceive(bench_objects.second, &message);
+    }
+    bench_print("queue ping-pong", start);
+
+    waitpid(pid, NULL);
+    pdelete(bench_objects.first);
+    pdelete(bench_objects.second);
+
+}
+
+// Request and reply
+
+static int bench_call_server(void *arg) {
+    (void) arg;
+    int message;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        int pid = preceive_call(bench_objects.first, &message);
+        preply(pid, message + 1);
+    }
+    return 0;
+}
+
+static void bench_call(void) {
+
+    // The queue ping-pong above is the emulation of a call.
+    bench_objects.first = pcreate(1);
+    int pid = bench_start(bench_call_server, "bench_call_server");
+
+    int reply;
+    unsigned long long start = bench_clock();
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+        pcall(bench_objects.first, i, &reply);
+    bench_print("call and reply", start);
+
+    waitpid(pid, NULL);
+    pdelete(bench_objects.first);
+
+}
+
+// Uncontended lock and unlock
+
+static void bench_lock(void) {
+
+    int mutex = mcreate();
+    unsigned long long start = bench_clock();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        mlock(mutex);
+        munlock(mutex);
+    }
+    bench_print("kernel mutex lock/unlock", start);
+    mdelete(mutex);
+
+    // The queue holds a single token, owned by the lock holder.
+    int token;
+    int queue = pcreate(1);
+    psend(queue, 0);
+    start = bench_clock();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        preceive(queue, &token);
+        psend(queue, token);
+    }
+    bench_print("queue token lock/unlock", start);
+    pdelete(queue);
+
+    mutex_init(&bench_objects.mutex);
+    start = bench_clock();
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        mutex_lock(&bench_objects.mutex);
+        mutex_unlock(&bench_objects.mutex);
+    }
+    bench_print("futex mutex lock/unlock", start);
+
+}
+
+// Barrier rounds
+
+static int bench_barrier_worker(void *arg) {
+    (void) arg;
+    for (int i = 0; i < BENCH_ITERATIONS; i++)
+        bwait(bench_objects.first);
+    return 0;
+}
+
+/// Arrivals are sent to the coordinator, that releases all workers
+/// once each of them has arrived.
+static int bench_queue_barrier_worker(void *arg) {
+    (void) arg;
+    int message;
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        psend(bench_objects.first, 0);
+        preceive(bench_objects.second, &message);
+    }
+    return 0;
+}
+
+static void bench_barrier(void) {
+
+    int pids[BENCH_BARRIER_PROCESSES];
+
+    bench_objects.first = bcreate(BENCH_BARRIER_PROCESSES);
+    unsigned long long start = bench_clock();
+    for (int i = 0; i < BENCH_BARRIER_PROCESSES; i++)
+        pids[i] = bench_start(bench_barrier_worker, "bench_barrier");
+    for (int i = 0; i < BENCH_BARRIER_PROCESSES; i++)
+        waitpid(pids[i], NULL);
+    bench_print("kernel barrier round", start);
+    bdelete(bench_objects.first);
+
+    bench_objects.first = pcreate(BENCH_BARRIER_PROCESSES);
+    bench_objects.second = pcreate(BENCH_BARRIER_PROCESSES);
+    int message;
+    start = bench_clock();
+    for (int i = 0; i < BENCH_BARRIER_PROCESSES; i++)
+        pids[i] = bench_start(bench_queue_barrier_worker, "bench_barrier");
+    for (int i = 0; i < BENCH_ITERATIONS; i++) {
+        for (int j = 0; j < BENCH_BARRIER_PROCESSES; j++)
+            preceive(bench_objects.first, &message);
+        for (int j = 0; j < BENCH_BARRIER_PROCESSES; j++)
+            psend(bench_objects.second, 0);
+    }
+    for (int i = 0; i < BENCH_BARRIER_PROCESSES; i++)
+        waitpid(pids[i], NULL);
+    bench_print("queue barrier round", start);
+    pdelete(bench_objects.first);
+    pdelete(bench_objects.second);
+
+}
+
+void bench_run(void) {
+    printf("\033eSystem calls (%d iterations):\033r\n", BENCH_ITERATIONS);
+    bench_getpid();
+    bench_ring();
+    printf("\033eSynchronization (%d iterations):\033r\n", BENCH_ITERATIONS);
+    bench_ping_pong();
+    bench_call();
+    bench_lock();
+    bench_barrier();
+}
@@ -0,0 +1,10 @@
+/// Micro-benchmarks of the kernel primitives, comparing them with
+/// their emulation using process queues, or with the slower path.
+
+#ifndef __BENCH_H__
+#define __BENCH_H__
+
+/// Run all benchmarks and print their results in cycles per operation.
+void bench_run(void);
+
+#endif
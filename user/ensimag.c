@@ -11,6 +11,32 @@
 #include "ensimag.h"
 
 
+/// Kernel data page, null if not available, in which case the values
+/// are read with syscalls.
+static const volatile struct vdso_data *vdso = NULL;
+
+void vdso_init(void) {
+    vdso = (const volatile struct vdso_data *) syscall0(SC_SYSTEM_VDSO);
+}
+
+/// Begin reading multiple values of the kernel data page, returning
+/// the sequence to check with 'vdso_read_retry'. Single values don't
+/// need it because they are read atomically.
+static unsigned int vdso_read_begin(void) {
+    unsigned int seq;
+    while ((seq = vdso->seq) & 1);
+    __asm__ __volatile__("" ::: "memory");
+    return seq;
+}
+
+/// Return true if the kernel updated the page since the given sequence
+/// and values must be read again.
+static int vdso_read_retry(unsigned int seq) {
+    __asm__ __volatile__("" ::: "memory");
+    return vdso->seq != seq;
+}
+
+
 int start(int (*pt_func)(void *), unsigned long ssize, int prio, const char *name, void *arg) {
     return syscall5(
         SC_PROCESS_START,
@@ -27,6 +53,8 @@ void exit(int retval) {
 }
 
 int getpid(void) {
+    if (vdso != NULL)
+        return vdso->pid;
     return syscall0(SC_PROCESS_PID);
 }
 
@@ -64,6 +92,18 @@ void wait_clock(unsigned long clock) {
     syscall1(SC_PROCESS_WAIT_CLOCK, clock);
 }
 
+int wait_any(const struct wait_source *sources, int count) {
+    return syscall2(SC_PROCESS_WAIT_ANY, (size_t) sources, count);
+}
+
+int futex_wait(const int *addr, int expected, unsigned long clock) {
+    return syscall3(SC_PROCESS_FUTEX_WAIT, (size_t) addr, expected, clock);
+}
+
+int futex_wake(const int *addr, int count) {
+    return syscall2(SC_PROCESS_FUTEX_WAKE, (size_t) addr, count);
+}
+
 int pcreate(int count) {
     return syscall1(SC_PROCESS_QUEUE_CREATE, count);
 }
@@ -88,11 +128,250 @@ int preset(int fid) {
     return syscall1(SC_PROCESS_QUEUE_RESET, fid);
 }
 
+int psend_many(int fid, const int *messages, int count) {
+    return syscall3(SC_PROCESS_QUEUE_SEND_MANY, fid, (size_t) messages, count);
+}
+
+int preceive_many(int fid, int *messages, int count, int min_count) {
+    return syscall4(SC_PROCESS_QUEUE_RECEIVE_MANY, fid, (size_t) messages, count, min_count);
+}
+
+int psend_try(int fid, int message) {
+    return psend_timed(fid, message, 0);
+}
+
+int preceive_try(int fid, int *message) {
+    return preceive_timed(fid, message, 0);
+}
+
+int psend_timed(int fid, int message, unsigned long clock) {
+    return syscall3(SC_PROCESS_QUEUE_SEND_TIMED, fid, message, clock);
+}
+
+int preceive_timed(int fid, int *message, unsigned long clock) {
+    return syscall3(SC_PROCESS_QUEUE_RECEIVE_TIMED, fid, (size_t) message, clock);
+}
+
+int presize(int fid, int capacity) {
+    return syscall2(SC_PROCESS_QUEUE_RESIZE, fid, capacity);
+}
+
+int pcall(int fid, int message, int *reply) {
+    return syscall3(SC_PROCESS_QUEUE_CALL, fid, message, (size_t) reply);
+}
+
+int preceive_call(int fid, int *message) {
+    return syscall2(SC_PROCESS_QUEUE_RECEIVE_CALL, fid, (size_t) message);
+}
+
+int preply(int pid, int message) {
+    return syscall2(SC_PROCESS_QUEUE_REPLY, pid, message);
+}
+
+int pcreate_prio(int count, int levels) {
+    return syscall2(SC_PROCESS_QUEUE_CREATE_PRIO, count, levels);
+}
+
+int psend_prio(int fid, int message, int priority) {
+    return syscall3(SC_PROCESS_QUEUE_SEND_PRIO, fid, message, priority);
+}
+
+int tcreate(int capacity, int policy) {
+    return syscall2(SC_PROCESS_TOPIC_CREATE, capacity, policy);
+}
+
+int tdelete(int tid) {
+    return syscall1(SC_PROCESS_TOPIC_DELETE, tid);
+}
+
+int tsubscribe(int tid) {
+    return syscall1(SC_PROCESS_TOPIC_SUBSCRIBE, tid);
+}
+
+int tunsubscribe(int tid, int fid) {
+    return syscall2(SC_PROCESS_TOPIC_UNSUBSCRIBE, tid, fid);
+}
+
+int tpublish(int tid, int message) {
+    return syscall2(SC_PROCESS_TOPIC_PUBLISH, tid, message);
+}
+
+int tdrops(int tid, int fid) {
+    return syscall2(SC_PROCESS_TOPIC_DROPS, tid, fid);
+}
+
+int dcreate(int capacity, int max_size) {
+    return syscall2(SC_PROCESS_DGRAM_CREATE, capacity, max_size);
+}
+
+int ddelete(int did) {
+    return syscall1(SC_PROCESS_DGRAM_DELETE, did);
+}
+
+int dsend(int did, const void *data, int size) {
+    return syscall3(SC_PROCESS_DGRAM_SEND, did, (size_t) data, size);
+}
+
+int dreceive(int did, void *data, int size) {
+    return syscall3(SC_PROCESS_DGRAM_RECEIVE, did, (size_t) data, size);
+}
+
+int dcount(int did, int *count, int *used) {
+    return syscall3(SC_PROCESS_DGRAM_COUNT, did, (size_t) count, (size_t) used);
+}
+
+int dreset(int did) {
+    return syscall1(SC_PROCESS_DGRAM_RESET, did);
+}
+
+int screate(int count) {
+    return syscall1(SC_PROCESS_SEM_CREATE, count);
+}
+
+int sdelete(int sem) {
+    return syscall1(SC_PROCESS_SEM_DELETE, sem);
+}
+
+int wait(int sem) {
+    return syscall1(SC_PROCESS_SEM_WAIT, sem);
+}
+
+int try_wait(int sem) {
+    return syscall1(SC_PROCESS_SEM_TRY_WAIT, sem);
+}
+
+int signal(int sem) {
+    return syscall2(SC_PROCESS_SEM_SIGNAL, sem, 1);
+}
+
+int signaln(int sem, int count) {
+    return syscall2(SC_PROCESS_SEM_SIGNAL, sem, count);
+}
+
+int scount(int sem) {
+    return syscall1(SC_PROCESS_SEM_COUNT, sem);
+}
+
+int sreset(int sem, int count) {
+    return syscall2(SC_PROCESS_SEM_RESET, sem, count);
+}
+
+int mcreate(void) {
+    return syscall0(SC_PROCESS_MUTEX_CREATE);
+}
+
+int mdelete(int mutex) {
+    return syscall1(SC_PROCESS_MUTEX_DELETE, mutex);
+}
+
+int mlock(int mutex) {
+    return syscall1(SC_PROCESS_MUTEX_LOCK, mutex);
+}
+
+int mtry_lock(int mutex) {
+    return syscall1(SC_PROCESS_MUTEX_TRY_LOCK, mutex);
+}
+
+int munlock(int mutex) {
+    return syscall1(SC_PROCESS_MUTEX_UNLOCK, mutex);
+}
+
+int ccreate(void) {
+    return syscall0(SC_PROCESS_COND_CREATE);
+}
+
+int cdelete(int cond) {
+    return syscall1(SC_PROCESS_COND_DELETE, cond);
+}
+
+int cwait(int cond, int mutex) {
+    return syscall2(SC_PROCESS_COND_WAIT, cond, mutex);
+}
+
+int csignal(int cond) {
+    return syscall1(SC_PROCESS_COND_SIGNAL, cond);
+}
+
+int cbroadcast(int cond) {
+    return syscall1(SC_PROCESS_COND_BROADCAST, cond);
+}
+
+int bcreate(int count) {
+    return syscall1(SC_PROCESS_BARRIER_CREATE, count);
+}
+
+int bdelete(int barrier) {
+    return syscall1(SC_PROCESS_BARRIER_DELETE, barrier);
+}
+
+int bwait(int barrier) {
+    return syscall1(SC_PROCESS_BARRIER_WAIT, barrier);
+}
+
+int breset(int barrier) {
+    return syscall1(SC_PROCESS_BARRIER_RESET, barrier);
+}
+
+int shm_create(int size) {
+    return syscall1(SC_PROCESS_SHM_CREATE, size);
+}
+
+void *shm_attach(int id) {
+    return (void *) syscall1(SC_PROCESS_SHM_ATTACH, id);
+}
+
+int shm_detach(void *addr) {
+    return syscall1(SC_PROCESS_SHM_DETACH, (size_t) addr);
+}
+
+int shm_destroy(int id) {
+    return syscall1(SC_PROCESS_SHM_DESTROY, id);
+}
+
+int ring_setup(struct syscall_ring *ring) {
+    return syscall1(SC_PROCESS_RING_SETUP, (size_t) ring);
+}
+
+int ring_submit(int count) {
+    return syscall1(SC_PROCESS_RING_SUBMIT, count);
+}
+
+int ring_queue(struct syscall_ring *ring, int num, const unsigned int args[5], unsigned int flags, unsigned int user_data) {
+
+    if (ring->sq_tail - ring->sq_head >= ring->size)
+        return -1;
+
+    struct syscall_ring_sqe *sqe = &ring->sq[ring->sq_tail & (ring->size - 1)];
+    sqe->num = num;
+    for (int i = 0; i < 5; i++)
+        sqe->args[i] = args != NULL ? args[i] : 0;
+    sqe->flags = flags;
+    sqe->user_data = user_data;
+
+    ring->sq_tail++;
+    return 0;
+
+}
+
 void clock_settings(unsigned long *quartz, unsigned long *ticks) {
-    syscall2(SC_CLOCK_SETTINGS, (size_t) quartz, (size_t) ticks);
+
+    if (vdso == NULL) {
+        syscall2(SC_CLOCK_SETTINGS, (size_t) quartz, (size_t) ticks);
+        return;
+    }
+
+    unsigned int seq;
+    do {
+        seq = vdso_read_begin();
+        *quartz = vdso->quartz;
+        *ticks = vdso->interval;
+    } while (vdso_read_retry(seq));
+
 }
 
 unsigned long current_clock() {
+    if (vdso != NULL)
+        return vdso->clock;
     return syscall0(SC_CLOCK_GET);
 }
 
@@ -118,6 +397,22 @@ int system_memory_info(unsigned int *capacity, unsigned int *used) {
     return syscall2(SC_SYSTEM_MEMORY_INFO, (size_t) capacity, (size_t) used);
 }
 
+int system_memory_trace(struct mem_trace_site *sites, int count) {
+    return syscall2(SC_SYSTEM_MEMORY_TRACE, (size_t) sites, count);
+}
+
+int system_syscall_stats(struct syscall_stat *stats, int count) {
+    return syscall2(SC_SYSTEM_SYSCALL_STATS, (size_t) stats, count);
+}
+
+int system_syscall_trace(int pid, int enable) {
+    return syscall2(SC_SYSTEM_SYSCALL_TRACE, pid, enable);
+}
+
+int system_syscall_trace_read(struct syscall_trace_entry *entries, int count) {
+    return syscall2(SC_SYSTEM_SYSCALL_TRACE_READ, (size_t) entries, count);
+}
+
 void system_power_off(void) {
     syscall0(SC_SYSTEM_POWER_OFF);
 }
@@ -1,6 +1,8 @@
 #ifndef __ENSIMAG_H__
 #define __ENSIMAG_H__
 
+#include "syscall_shared.h"
+
 typedef int (*process_func_t)(void *);
 
 int start(process_func_t pt_func, unsigned long ssize, int prio, const char *name, void *arg);
@@ -15,6 +17,9 @@ int getchildren(int pid, int *children_pids, int count);
 int getstate(int pid);
 
 void wait_clock(unsigned long clock);
+int wait_any(const struct wait_source *sources, int count);
+int futex_wait(const int *addr, int expected, unsigned long clock);
+int futex_wake(const int *addr, int count);
 
 int pcreate(int count);
 int pdelete(int fid);
@@ -22,6 +27,71 @@ int psend(int fid, int message);
 int preceive(int fid, int *message);
 int pcount(int fid, int *count);
 int preset(int fid);
+/// Returns the number of messages sent, less than count if the queue
+/// is deleted or reset meanwhile, or -1 if none was sent.
+int psend_many(int fid, const int *messages, int count);
+/// Returns the number of messages received, less than min_count if the
+/// queue is deleted or reset meanwhile, or -1 if none was received.
+int preceive_many(int fid, int *messages, int count, int min_count);
+int psend_try(int fid, int message);
+int preceive_try(int fid, int *message);
+int psend_timed(int fid, int message, unsigned long clock);
+int preceive_timed(int fid, int *message, unsigned long clock);
+int presize(int fid, int capacity);
+int pcall(int fid, int message, int *reply);
+int preceive_call(int fid, int *message);
+int preply(int pid, int message);
+int pcreate_prio(int count, int levels);
+int psend_prio(int fid, int message, int priority);
+
+int tcreate(int capacity, int policy);
+int tdelete(int tid);
+int tsubscribe(int tid);
+int tunsubscribe(int tid, int fid);
+int tpublish(int tid, int message);
+int tdrops(int tid, int fid);
+
+int dcreate(int capacity, int max_size);
+int ddelete(int did);
+int dsend(int did, const void *data, int size);
+int dreceive(int did, void *data, int size);
+int dcount(int did, int *count, int *used);
+int dreset(int did);
+
+int screate(int count);
+int sdelete(int sem);
+int wait(int sem);
+int try_wait(int sem);
+int signal(int sem);
+int signaln(int sem, int count);
+int scount(int sem);
+int sreset(int sem, int count);
+
+int mcreate(void);
+int mdelete(int mutex);
+int mlock(int mutex);
+int mtry_lock(int mutex);
+int munlock(int mutex);
+
+int ccreate(void);
+int cdelete(int cond);
+int cwait(int cond, int mutex);
+int csignal(int cond);
+int cbroadcast(int cond);
+
+int bcreate(int count);
+int bdelete(int barrier);
+int bwait(int barrier);
+int breset(int barrier);
+
+int shm_create(int size);
+void *shm_attach(int id);
+int shm_detach(void *addr);
+int shm_destroy(int id);
+
+int ring_setup(struct syscall_ring *ring);
+int ring_submit(int count);
+int ring_queue(struct syscall_ring *ring, int num, const unsigned int args[5], unsigned int flags, unsigned int user_data);
 
 void clock_settings(unsigned long *quartz, unsigned long *ticks);
 unsigned long current_clock();
@@ -31,6 +101,10 @@ int cons_read(char *string, unsigned long length);
 void cons_write(const char *str, long size);
 
 int system_memory_info(unsigned int *capacity, unsigned int *used);
+int system_memory_trace(struct mem_trace_site *sites, int count);
+int system_syscall_stats(struct syscall_stat *stats, int count);
+int system_syscall_trace(int pid, int enable);
+int system_syscall_trace_read(struct syscall_trace_entry *entries, int count);
 void system_power_off(void);
 
 #endif
@@ -1,5 +1,7 @@
 #include "ensimag.h"
 #include "shell.h"
+#include "bench.h"
+#include "div64.h"
 
 #include "stdbool.h"
 #include "string.h"
@@ -10,6 +12,9 @@
 #define COMMAND_BUFFER_CAP 1024
 #define ARGS_CAP 128
 
+#define SYSSTAT_TOP 10
+#define STRACE_TAIL 16
+
 
 /// Builtin help command that displays all builtin commands.
 static bool builtin_help(size_t argc, const char **args);
@@ -18,6 +23,10 @@ static bool builtin_exit(size_t argc, const char **args);
 static bool builtin_echo(size_t argc, const char **args);
 static bool builtin_test(size_t argc, const char **args);
 static bool builtin_time(size_t argc, const char **args);
+static bool builtin_memtrace(size_t argc, const char **args);
+static bool builtin_bench(size_t argc, const char **args);
+static bool builtin_sysstat(size_t argc, const char **args);
+static bool builtin_strace(size_t argc, const char **args);
 
 struct builtin {
     const char *name;
@@ -63,6 +72,30 @@ struct builtin builtins[] = {
         "Get current time since startup of the system.",
         builtin_time
     },
+    {
+        "memtrace",
+        "",
+        "Display live kernel allocations grouped by call site.",
+        builtin_memtrace
+    },
+    {
+        "bench",
+        "",
+        "Run micro-benchmarks of the kernel primitives.",
+        builtin_bench
+    },
+    {
+        "sysstat",
+        "",
+        "Display the most called syscalls and their average time.",
+        builtin_sysstat
+    },
+    {
+        "strace",
+        "[<pid> <on|off>]",
+        "Trace the syscalls of a process, or display the last traced.",
+        builtin_strace
+    },
     { 0 }
 };
 
@@ -173,6 +206,12 @@ static const char *get_state_name(int state) {
         case 4: return "wait-queue";
         case 5: return "wait-cons";
         case 6: return "zombie";
+        case 7: return "wait-dgram";
+        case 8: return "wait-any";
+        case 9: return "wait-futex";
+        case 10: return "wait-sync";
+        case 11: return "wait-call";
+        case 12: return "wait-reply";
         default: return "unknown";
     }
 }
@@ -325,3 +364,118 @@ static bool builtin_time(size_t argc, const char **args) {
 
 
 }
+
+static bool builtin_memtrace(size_t argc, const char **args) {
+
+    (void) args;
+    if (argc != 1)
+        return false;
+
+    struct mem_trace_site sites[16];
+    int count = system_memory_trace(sites, 16);
+    if (count < 0) {
+        printf("\033cAllocation tracing is disabled, build with MEM_TRACE=1.\033r\n");
+        return true;
+    }
+
+    printf("\033eLive kernel allocations:\033r\n");
+    printf("  site        count      bytes\n");
+    for (int i = 0; i < count; i++) {
+        if (sites[i].site != 0) {
+            printf("  0x%08x %6u %10u\n", sites[i].site, sites[i].count, sites[i].bytes);
+        } else {
+            printf("  (other)    %6u %10u\n", sites[i].count, sites[i].bytes);
+        }
+    }
+    printf("Resolve sites with 'kernel/build/symbolize.sh < dump.txt'.\n");
+
+    return true;
+
+}
+
+static bool builtin_bench(size_t argc, const char **args) {
+
+    (void) args;
+    if (argc != 1)
+        return false;
+
+    bench_run();
+    return true;
+
+}
+
+static bool builtin_sysstat(size_t argc, const char **args) {
+
+    (void) args;
+    if (argc != 1)
+        return false;
+
+    static struct syscall_stat stats[SYSCALL_COUNT];
+    int count = system_syscall_stats(stats, SYSCALL_COUNT);
+    if (count < 0)
+        return true;
+
+    printf("\033eMost called syscalls:\033r\n");
+    printf("  num      count  cycles/call\n");
+
+    // Selection of the top entries, a printed entry is cleared.
+    for (int rank = 0; rank < SYSSTAT_TOP; rank++) {
+
+        int top = -1;
+        for (int i = 0; i < count; i++) {
+            if (stats[i].count != 0 && (top < 0 || stats[i].count > stats[top].count))
+                top = i;
+        }
+
+        if (top < 0)
+            break;
+
+        unsigned long average = div64(stats[top].cycles, stats[top].count);
+        printf("  %3d %10u %12lu\n", top, stats[top].count, average);
+        stats[top].count = 0;
+
+    }
+
+    return true;
+
+}
+
+static bool builtin_strace(size_t argc, const char **args) {
+
+    if (argc == 3) {
+
+        int pid = strtoul(args[1], NULL, 10);
+        int enable;
+        if (strcmp("on", args[2]) == 0) {
+            enable = 1;
+        } else if (strcmp("off", args[2]) == 0) {
+            enable = 0;
+        } else {
+            return false;
+        }
+
+        if (system_syscall_trace(pid, enable) < 0) {
+            printf("\033cNo process with PID %d.\033r\n", pid);
+        }
+
+        return true;
+
+    } else if (argc != 1) {
+        return false;
+    }
+
+    static struct syscall_trace_entry entries[STRACE_TAIL];
+    int count = system_syscall_trace_read(entries, STRACE_TAIL);
+
+    printf("\033eLast traced syscalls:\033r\n");
+    for (int i = 0; i < count; i++) {
+        struct syscall_trace_entry *entry = &entries[i];
+        printf("  [%d] %u(0x%x, 0x%x, 0x%x, 0x%x, 0x%x) = %d, %lu cycles\n",
+            entry->pid, entry->num,
+            entry->args[0], entry->args[1], entry->args[2], entry->args[3], entry->args[4],
+            entry->ret, (unsigned long) entry->cycles);
+    }
+
+    return true;
+
+}
@@ -1,6 +1,7 @@
 #include "ensimag.h"
 #include "shell.h"
 #include "start.h"
+#include "syscall.h"
 
 #include "stddef.h"
 
@@ -8,6 +9,8 @@
 // Idle process entry of the user space.
 void user_start(void) {
 	
+	syscall_init();
+	vdso_init();
 	start(shell_start, 8192, 1, "shell", NULL);
 	while (1);
 	
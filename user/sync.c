@@ -0,0 +1,72 @@
+#include "sync.h"
+#include "ensimag.h"
+
+
+void mutex_init(struct mutex *mutex) {
+    mutex->state = 0;
+}
+
+void mutex_lock(struct mutex *mutex) {
+
+    // Fast path, the mutex was unlocked.
+    int state = __sync_val_compare_and_swap(&mutex->state, 0, 1);
+    if (state == 0)
+        return;
+
+    // Mark the mutex as contended before sleeping, so that the owner
+    // wakes us up when unlocking, we own it if it was unlocked.
+    if (state != 2)
+        state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+
+    while (state != 0) {
+        futex_wait(&mutex->state, 2, 0);
+        state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+    }
+
+}
+
+int mutex_try_lock(struct mutex *mutex) {
+    return __sync_bool_compare_and_swap(&mutex->state, 0, 1);
+}
+
+void mutex_unlock(struct mutex *mutex) {
+    // Only call the kernel if some process may be waiting.
+    if (__atomic_exchange_n(&mutex->state, 0, __ATOMIC_RELEASE) == 2)
+        futex_wake(&mutex->state, 1);
+}
+
+void cond_init(struct cond *cond) {
+    cond->seq = 0;
+    cond->waiters = 0;
+}
+
+void cond_wait(struct cond *cond, struct mutex *mutex) {
+
+    // A signal between the unlock and the wait changes the sequence,
+    // so the wait returns immediately.
+    int seq = __atomic_load_n(&cond->seq, __ATOMIC_ACQUIRE);
+    __atomic_add_fetch(&cond->waiters, 1, __ATOMIC_RELAXED);
+    mutex_unlock(mutex);
+    futex_wait(&cond->seq, seq, 0);
+    __atomic_sub_fetch(&cond->waiters, 1, __ATOMIC_RELAXED);
+
+    // Other processes may be waiting for the mutex.
+    int state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+    while (state != 0) {
+        futex_wait(&mutex->state, 2, 0);
+        state = __atomic_exchange_n(&mutex->state, 2, __ATOMIC_ACQUIRE);
+    }
+
+}
+
+void cond_signal(struct cond *cond) {
+    __atomic_add_fetch(&cond->seq, 1, __ATOMIC_RELEASE);
+    if (__atomic_load_n(&cond->waiters, __ATOMIC_RELAXED) != 0)
+        futex_wake(&cond->seq, 1);
+}
+
+void cond_broadcast(struct cond *cond) {
+    __atomic_add_fetch(&cond->seq, 1, __ATOMIC_RELEASE);
+    if (__atomic_load_n(&cond->waiters, __ATOMIC_RELAXED) != 0)
+        futex_wake(&cond->seq, 0x7FFFFFFF);
+}
@@ -0,0 +1,36 @@
+/// User space mutexes and condition variables built on futexes, no
+/// syscall is made when there is no contention.
+
+#ifndef __SYNC_H__
+#define __SYNC_H__
+
+/// A mutex, must be initialized with 'mutex_init' or zeroed.
+struct mutex {
+    /// 0 if unlocked, 1 if locked, 2 if locked and processes may be
+    /// waiting for it.
+    int state;
+};
+
+/// A condition variable, must be initialized with 'cond_init' or 
+/// zeroed.
+struct cond {
+    /// Incremented on each signal, waiters sleep while unchanged.
+    int seq;
+    /// Number of waiting processes, signals without waiters are free.
+    int waiters;
+};
+
+void mutex_init(struct mutex *mutex);
+void mutex_lock(struct mutex *mutex);
+/// Return 1 if the mutex has been locked, 0 otherwise.
+int mutex_try_lock(struct mutex *mutex);
+void mutex_unlock(struct mutex *mutex);
+
+void cond_init(struct cond *cond);
+/// Atomically unlock the mutex and wait for a signal, the mutex is
+/// locked again when returning. Spurious wakeups are possible.
+void cond_wait(struct cond *cond, struct mutex *mutex);
+void cond_signal(struct cond *cond);
+void cond_broadcast(struct cond *cond);
+
+#endif
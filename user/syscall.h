@@ -6,6 +6,16 @@
 #include "syscall_shared.h"
 #include "stddef.h"
 
+/// Non-zero if syscalls use SYSENTER instead of the interrupt, can be
+/// cleared to force the interrupt.
+extern int syscall_fast;
+
+/// Detect if SYSENTER can be used, must be called once at startup.
+void syscall_init(void);
+/// Locate the kernel data page, must be called once at startup, see
+/// 'SC_SYSTEM_VDSO'.
+void vdso_init(void);
+
 size_t syscall0(size_t num);
 size_t syscall1(size_t num, size_t p0);
 size_t syscall2(size_t num, size_t p0, size_t p1);